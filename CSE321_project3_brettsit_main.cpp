@@ -4,27 +4,75 @@
  * Purpose: Interior climate monitoring and alarm system
  *
  * Modules/Subroutines:
- *  ISR Functions:
- *      - void isr_c0(): ISR for column 0 - allows user to input values '1', '4', and '7' from keypad
- *      - void isr_c1(): ISR for column 1 - allows user to input values '2', '5', '8', and '0' from keypad
- *      - void isr_c2(): ISR for column 2 - allows user to input values '3', '6', and '9' from keypad
- *      - void isr_c3(): ISR for column 3 - allows user to control monitor state from keypad
+ *  Keypad Input (runs on main while a key is down):
+ *      - void key_event(KeyEvent event): keypad scan callback - turns key presses, releases, long presses and repeats
+ *        into events for the mode state machine
+ *      - void flash(): light the LED for FLASH_TIME on a key press, except in ALERT mode where the alarm owns it
+ *      - void led_off(): flash timeout ISR, restore the LED level the mode wants
+ *      - void report_keypad(): print the number of scans dropped because of ghosting
+ *      - void set_led(int on), void set_buzzer(int on): switch an output and account for its on-time
  *
  *  Functions to Update Monitor State:
- *      - void update_sensor(): read current climate data from DHT11 temperature & humidity sensor
- *      - void beep_and_flash(int millisec): beep the buzzer and flash the LED for millisec milliseconds
- *      - void flash(int millisec): flash the LED for millisec milliseconds
- *      - void monitor_state(): t_monitor callback, switch system to alert mode when climate is out of range
- *      - void alert(): put device into alert mode, blink LED and ring buzzer on interval
+ *      - int read_sensor(size_t channel): read one temperature & humidity sensor; on success publish, post EVENT_SAMPLE
+ *        and schedule the sensor's next read from its rate of change and distance to the range; return the status so
+ *        the scheduler can retry and back off
+ *      - void publish_sample(size_t channel, const SensorSample &sample): publish a good sample, post EVENT_SAMPLE and
+ *        schedule the sensor's next read
+ *      - void sensor_lost(size_t channel): a sensor failed SENSOR_MAX_RETRIES reads in a row, publish an invalid reading
+ *      - void range_changed(): a new range was published, have t_monitor check it against a fresh enough reading
+ *      - void recheck_range(): on t_monitor, read again through the scheduler only the sensors whose sample is older than SENSOR_INTERVAL
+ *      - void monitor_state(): t_monitor callback, read the sensors in staggered slots
+ *      - void report_decode(): print the bit threshold and confidence of probe0's last frame
+ *      - ActivityCounters collect_activity(): gather what every component has done since boot
+ *      - void report_energy(): estimate the average current and mAh/day from each component's activity since boot
+ *      - void record_sample(const Reading &reading): store a reading in the history and queue it for the telemetry stream
+ *      - void send_diagnostics(): send CPU use, heap, sensor reads and the energy estimate as a telemetry record
+ *      - void check_range(int arg): new reading in MONITOR mode, post EVENT_OUT_OF_RANGE when climate is out of range
+ *      - void show_alert(int reason): tell the user which limit was crossed, and send it as telemetry
+ *      - void start_alarm(), void stop_alarm(), void toggle_alarm(): blink LED and ring buzzer on interval in ALERT mode
+ *
+ *  User Interface (runs on t_lcd, driven by events queued on ui_queue):
+ *      - void update_lcd(): t_lcd callback, dispatch events through the mode state machine
+ *      - void post_event(int event, int arg): queue an event for the mode state machine, ISR safe
+ *      - void dispatch_event(int event, int arg, uint32_t posted_us): run one event through the mode state machine
+ *      - void show_status(): display climate information in MONITOR and IDLE mode
+ *      - void refresh_status(int arg): new reading in IDLE mode
+ *      - void toggle_unit(int arg): flip unit between celcius and fahrenheit
  *
  *  Functions for Getting Input:
- *      - void print_prompt(char *prompt): print the input prompt to LCD
- *      - void get_input(char *prompt, int current_stage): print the prompt and current user inputted value as the they enter it
- *      - bool validate_input(): return true if input is valid, false if it is invalid
+ *      - void start_input(): INPUT mode entry, begin the input wizard at the first prompt
+ *      - void restart_input(int arg): start the wizard over after an invalid range
+ *      - void begin_prompt(int stage, int previous): open the entry for a prompt with the range its value has to be in
+ *      - void enter_digit(int digit): key event for '0'-'9', add the digit to the current entry
+ *      - void toggle_sign(int arg): short press of '*' in INPUT mode, flip the sign of the current entry
+ *      - void decimal_point(int arg): short press of '#' in INPUT mode, start the tenths of the current entry
+ *      - void backspace_input(int arg): short press of 'C' in INPUT mode, remove the last digit of the current entry
+ *      - void clear_input(int arg): long press of 'C' in INPUT mode, clear the current entry
+ *      - void step_input(int delta): '*' or '#' held in INPUT mode, scroll the current entry down or up by one
+ *      - void confirm_input(int arg): key event for 'A', store the current entry and move on to the next prompt
+ *      - void store_input(int stage): convert the confirmed entry to its internal value
+ *      - void finish_input(): publish the entered range, post EVENT_INPUT_VALID or EVENT_INPUT_INVALID
+ *      - void show_invalid(int arg): tell the user the range was invalid
+ *      - void show_entry(): show the prompt with the current entry as typed
+ *      - void show_range(): show the range the current entry has to be in
+ *      - void print_prompt(char *prompt): print the input prompt to LCD, through the display server
+ *      - bool validate_input(const Thresholds &entered): return true if input is valid, false if it is invalid
+ *
+ *  Serial Commands (run on the command thread, see command.h):
+ *      - int get_thresholds(const uint8_t *args, CommandReply &reply): reply with the range
+ *      - int set_thresholds(const uint8_t *args, CommandReply &reply): validate and publish a new range
+ *      - int get_unit(const uint8_t *args, CommandReply &reply), int set_unit(const uint8_t *args, CommandReply &reply):
+ *        read or change the unit shown on the LCD
+ *      - void apply_unit(int unit): change the unit on t_lcd and redraw the status screen
+ *      - int get_period(const uint8_t *args, CommandReply &reply): reply with a sensor's current and fixed period
+ *      - int set_period(const uint8_t *args, CommandReply &reply): read a sensor at a fixed period, or adaptively
+ *      - int get_stats(const uint8_t *args, CommandReply &reply): reply with uptime, sensor reads, dropped telemetry,
+ *        commands handled, the worst command latency and heap use
  *
  *  Functions for Converting Values:
- *      - float toFahrenheit(int celcius): convert celcius to fahrenheit
- *      - int toCelcius(float fahrenheit): convert fahrenheit to celcius
+ *      - int divide_rounded(int numerator, int denominator): divide, rounding to the nearest integer
+ *      - int toFahrenheit(int celcius): convert tenths of a degree celcius to fahrenheit
+ *      - int toCelcius(int fahrenheit): convert tenths of a degree fahrenheit to celcius
  *
  *
  * Corresponding Assignments: Project 3
@@ -35,10 +83,11 @@
  *      - A: Confirm Entered Value for Entry
  *      - B: Switch to IDLE mode
  *      - C: Change unit of measurement
- *           Clear currnet entry in INPUT mode
+ *           in INPUT mode remove the last digit, hold to clear current entry
         - D: Switch to INPUT mode
         - 0-9: Enter Values
-        - no programmed functionality for '#' and '*'
+        - *: in INPUT mode flip the sign, hold to scroll the current entry down
+        - #: in INPUT mode enter the decimal point, hold to scroll the current entry up
  *
  * Ouputs:
  *  - Buzzer: rings when monitor detects climate is out of range
@@ -51,6 +100,13 @@
  *      - warn user about invalid input
  *      - notify user when unit changes
  *      - alert user when monitor detects climate is out of range
+ *  - Serial (USB): periodic diagnostics report - CPU utilization, per-thread runtime,
+ *                  stack high-water marks, heap usage, mode changes and key reaction time,
+ *                  sensor outcomes, the longest interrupt masked sensor frame and the energy estimate
+ *                - or, with telemetry-enabled, a binary stream of samples, alerts and diagnostics (telemetry.h),
+ *                  and the stored sample history on request (history.h)
+ *  - Serial (USB) input, with telemetry-enabled: commands to get and set the range, unit and sampling period,
+ *    and to dump statistics (command.h), each answered with its latency
  *
  * Constraints:
  *  - Needs to help solve a problem: Food Waste Minimization
@@ -77,129 +133,267 @@
 #include "mbed_events.h"
 #include "stdio.h"
 #include "1802.h"
+#include "adaptive_rate.h"
+#include "display.h"
+#include "climate_sensor.h"
+#include "command.h"
 #include "DHT.h"
-#include <string>
+#include "diagnostics.h"
+#include "energy.h"
+#include "history.h"
+#include "heap_guard.h"
+#include "irq_window.h"
+#include "keypad.h"
+#include "numeric_entry.h"
+#include "sensor_scheduler.h"
+#include "sht3x.h"
+#include "state.h"
+#include "state_machine.h"
+#include "telemetry.h"
 
 // NOTE: This program contains code from my project 2 submission. Here are the things reused:
 //          - the main() function, for polling the keypad rows
-//          - the ISRs, for determining which column corresponds to the user input
+//          - the keypad wiring, for determining which key corresponds to the row and column
 //          - LCD initialization
 
-// configure inputs for keypad - each interrupt represents a column
-InterruptIn c0(PC_0, PullDown); // connected to: keypad line 4
-InterruptIn c1(PC_3, PullDown); // connected to: keypad line 3
-InterruptIn c2(PC_1, PullDown); // connected to: keypad line 2
-InterruptIn c3(PC_4, PullDown); // connected to: keypad line 1
-
-#define BOUNCE 1000  // the amount of time we wait in order to address bounce
-void isr_c0();
-void isr_c1();
-void isr_c2();
-void isr_c3();
-int row = -1;
+// keypad - all rows are powered from PF_12..PF_15 while idle, a column interrupt starts a full matrix scan
+constexpr char keymap[4][4] = {
+    {'1', '2', '3', 'A'},       // row 0: PF_12 - connected to: keypad line 8
+    {'4', '5', '6', 'B'},       // row 1: PF_13 - connected to: keypad line 7
+    {'7', '8', '9', 'C'},       // row 2: PF_14 - connected to: keypad line 6
+    {'*', '0', '#', 'D'},       // row 3: PF_15 - connected to: keypad line 5
+};
+const PinName keypad_columns[4] = {
+    PC_0,                       // connected to: keypad line 4
+    PC_3,                       // connected to: keypad line 3
+    PC_1,                       // connected to: keypad line 2
+    PC_4,                       // connected to: keypad line 1
+};
+void key_event(KeyEvent event);
+void report_keypad();
+KeypadMatrix<4, 4, keymap, 12> keypad(GPIOF, keypad_columns, callback(key_event));
+#define KEYPAD_SCAN_PERIOD 5ms  // time between matrix scans while a key is down, debounce takes KEYPAD_DEBOUNCE_SCANS of these
+#define LONG_PRESS std::chrono::milliseconds(MBED_CONF_APP_KEYPAD_LONG_PRESS_MS)  // hold time before a key repeats
+#define REPEAT_TIME std::chrono::milliseconds(MBED_CONF_APP_KEYPAD_REPEAT_MS)     // time between repeats of a held key
 
 // LCD
-CSE321_LCD lcd(16, 2, LCD_5x8DOTS, PF_0, PF_1); // connected to: PF_0 - SDA, PF_1 - SCL
-Thread t_lcd;                                   // this thread updates the LCD
+CSE321_LCD lcd(16, 2, LCD_5x8DOTS, PF_0, PF_1); // connected to: PF_0 - SDA, PF_1 - SCL - owned by the display server (display.h)
+MBED_ALIGN(8) unsigned char lcd_stack[MBED_CONF_APP_LCD_STACK_SIZE];
+Thread t_lcd(osPriorityNormal, sizeof(lcd_stack), lcd_stack, "lcd");    // this thread runs the user interface: status screen and input prompts
+unsigned char ui_queue_buffer[16 * EVENTS_EVENT_SIZE];
+EventQueue ui_queue(sizeof(ui_queue_buffer), ui_queue_buffer);   // key events from the keypad scan, dispatched by t_lcd
 void update_lcd();
+void show_status();
+void refresh_status(int arg);
+void post_event(int event, int arg);
+void dispatch_event(int event, int arg, uint32_t posted_us);
 
-// DHT 11
-DHT11 sensor(PG_0);
-int celcius;
-float fahrenheit;
-int humidity;
-
-void update_sensor();
+// climate sensors - add a probe by declaring its driver (DHT11, DHT22 or SHT3x) and adding it to sensors,
+// reads are staggered across all of them
+DHT11 probe0(PG_0);
+SensorArray<DHT11> sensors(probe0);
+#define SENSOR_COUNT sensors.size()
+int read_sensor(size_t channel);
+void publish_sample(size_t channel, const SensorSample &sample);
+void sensor_lost(size_t channel);
+void range_changed();
+void recheck_range();
+void report_decode();
+void report_energy();
 
 // Buzzer
 DigitalOut buzzer(PC_8);
+ActivityTimer buzzer_time;      // how long the buzzer has sounded, for the energy estimate
+void set_buzzer(int on);
 
 // LED
 DigitalOut led(PB_8);
-void flash(int millisec);
+ActivityTimer led_time;         // how long the LED has been lit, for the energy estimate
+void set_led(int on);
+LowPowerTimeout led_timeout;   // runs from the low power timer, so a flash does not keep the core out of stop mode
+#define FLASH_TIME 200ms        // how long the LED lights up for a key press
+void flash();
+void led_off();
 
 // getting input
-#define MAX_INPUT 9             // the maximum number of digits a user can enter on the display
-int input_stage = -1;           // flag for determining which input to get (min temp, max temp, min humidity, max humidity)
-int input_len = -1;
-string input_str;               // used to store the user input as it is entered
-bool input_modified = false;    // flag for determining when to update the lcd to display the user input
+NumericEntry entry;             // value being entered, parsed as it is typed - only touched by t_lcd
+Thresholds entered;             // range being entered, only published once it is valid
 char prompts[4][17] = {
     "Min Temperature?",
     "Max Temperature?",
     "Min Humidity?",
     "Max Humidity?"
 };
+void start_input();
+void restart_input(int arg);
+void begin_prompt(int stage, int previous);
+void enter_digit(int digit);
+void toggle_sign(int arg);
+void decimal_point(int arg);
+void backspace_input(int arg);
+void clear_input(int arg);
+void step_input(int delta);
+void confirm_input(int arg);
+void store_input(int stage);
+void finish_input();
+void show_invalid(int arg);
+void show_entry();
+void show_range();
 void print_prompt(char *prompt);
-void get_input(char *prompt, int current_stage);
-bool validate_input();
+bool validate_input(const Thresholds &entered);
 
 // update monitor state
-Thread t_monitor;               // thread for monitoring climate
+MBED_ALIGN(8) unsigned char monitor_stack[MBED_CONF_APP_MONITOR_STACK_SIZE];
+Thread t_monitor(osPriorityNormal, sizeof(monitor_stack), monitor_stack, "monitor");   // thread for sampling the climate
+unsigned char monitor_queue_buffer[4 * EVENTS_EVENT_SIZE];
+EventQueue monitor_queue(sizeof(monitor_queue_buffer), monitor_queue_buffer);
+// how often each sensor is read, never faster than the slowest sensor allows
+#define SENSOR_INTERVAL std::chrono::milliseconds(MBED_CONF_APP_SENSOR_INTERVAL_MS > sensors.min_interval_ms() ? \
+                                                  MBED_CONF_APP_SENSOR_INTERVAL_MS : sensors.min_interval_ms())
+SensorScheduler scheduler(SENSOR_COUNT, SENSOR_INTERVAL, callback(read_sensor), callback(sensor_lost));
+// a steady climate far from the range is read less often, never less than every SENSOR_MAX_INTERVAL
+#define SENSOR_MAX_INTERVAL MBED_CONF_APP_SENSOR_MAX_INTERVAL_MS
+SensorSample last_sample[SENSOR_COUNT];    // each sensor's previous good sample, for its rate of change - only touched by t_monitor
+std::atomic<uint32_t> fixed_period_ms[SENSOR_COUNT];   // period set over serial for each sensor, 0 to pick it adaptively
 void monitor_state();
-void beep_and_flash(int millisec);
-void alert();
-
-// internal state variables
-EventQueue queue(32 * EVENTS_EVENT_SIZE);   // allows ISR to tell polling loop to sleep in order to address bounce
-#define TEMP_MIN_C 0
-#define TEMP_MIN_F 32
-int temp_min_c = TEMP_MIN_C;
-float temp_min_f = TEMP_MIN_F; 
-#define TEMP_MAX_C 50                            
-#define TEMP_MAX_F 122
-int temp_max_c = TEMP_MAX_C;
-float temp_max_f = TEMP_MAX_F;
-#define HUMIDITY_MIN 20
-int humidity_min = HUMIDITY_MIN;
-#define HUMIDITY_MAX 95
-int humidity_max = HUMIDITY_MAX;
-
-#define FAHRENHEIT false
-#define CELCIUS true
-bool unit = CELCIUS;
-
-#define IDLE 0
-#define INPUT 1
-#define MONITOR 2
-#define ALERT 3
-int mode = IDLE;
+void check_range(int arg);
+void show_alert(int reason);
+void toggle_unit(int arg);
+
+// alarm
+#define ALARM_INTERVAL 1000ms   // buzzer and LED are on for one interval, then off for one interval
+int alarm_event = 0;            // ui_queue id of the periodic alarm toggle, 0 when the alarm is off
+void start_alarm();
+void stop_alarm();
+void toggle_alarm();
+
+// internal state variables - mode, unit, thresholds and readings live in the state store (state.h)
+
+// events processed by the mode state machine
+#define EVENT_KEY_A 0
+#define EVENT_KEY_B 1
+#define EVENT_KEY_C 2
+#define EVENT_KEY_D 3
+#define EVENT_DIGIT 4           // arg: the digit character
+#define EVENT_INPUT_VALID 5     // all four values entered and valid
+#define EVENT_INPUT_INVALID 6   // all four values entered but not a valid range
+#define EVENT_INPUT_RETRY 7     // "Invalid Input" message has been shown long enough
+#define EVENT_SAMPLE 8          // t_monitor published a new reading, arg: which sensor
+#define EVENT_OUT_OF_RANGE 9    // arg: which limit was crossed
+#define EVENT_CLEAR 10          // 'C' held
+#define EVENT_STEP 11           // '*' or '#' held, arg: -1 or +1
+#define EVENT_SIGN 12           // '*' pressed
+#define EVENT_POINT 13          // '#' pressed
+const char *const event_names[] = {
+    "A", "B", "C", "D", "digit", "valid", "invalid", "retry", "sample", "range", "clear", "step", "sign", "point"
+};
+
+// reasons for EVENT_OUT_OF_RANGE
+#define TEMP_TOO_LOW 0
+#define TEMP_TOO_HIGH 1
+#define HUMIDITY_TOO_LOW 2
+#define HUMIDITY_TOO_HIGH 3
+
+// mode state machine - the only place the mode changes
+const FsmState mode_states[] = {
+//   state    name       entry         exit
+    {IDLE,    "IDLE",    show_status,  nullptr},
+    {INPUT,   "INPUT",   start_input,  nullptr},
+    {MONITOR, "MONITOR", show_status,  nullptr},
+    {ALERT,   "ALERT",   start_alarm,  stop_alarm},
+};
+const FsmTransition mode_transitions[] = {
+//   state    event                action         next
+    {IDLE,    EVENT_KEY_C,         toggle_unit,   IDLE},
+    {IDLE,    EVENT_KEY_D,         nullptr,       INPUT},
+    {IDLE,    EVENT_SAMPLE,        refresh_status, IDLE},
+    {INPUT,   EVENT_DIGIT,         enter_digit,   INPUT},
+    {INPUT,   EVENT_KEY_A,         confirm_input, INPUT},
+    {INPUT,   EVENT_KEY_C,         backspace_input, INPUT},
+    {INPUT,   EVENT_CLEAR,         clear_input,   INPUT},
+    {INPUT,   EVENT_STEP,          step_input,    INPUT},
+    {INPUT,   EVENT_SIGN,          toggle_sign,   INPUT},
+    {INPUT,   EVENT_POINT,         decimal_point, INPUT},
+    {INPUT,   EVENT_INPUT_VALID,   nullptr,       MONITOR},
+    {INPUT,   EVENT_INPUT_INVALID, show_invalid,  INPUT},
+    {INPUT,   EVENT_INPUT_RETRY,   restart_input, INPUT},
+    {MONITOR, EVENT_KEY_B,         nullptr,       IDLE},
+    {MONITOR, EVENT_KEY_C,         toggle_unit,   MONITOR},
+    {MONITOR, EVENT_KEY_D,         nullptr,       INPUT},
+    {MONITOR, EVENT_SAMPLE,        check_range,   MONITOR},
+    {MONITOR, EVENT_OUT_OF_RANGE,  show_alert,    ALERT},
+    {ALERT,   EVENT_KEY_B,         nullptr,       IDLE},
+    {ALERT,   EVENT_KEY_C,         toggle_unit,   ALERT},
+    {ALERT,   EVENT_KEY_D,         nullptr,       INPUT},
+};
+StateMachine mode_machine(mode_states, sizeof(mode_states) / sizeof(mode_states[0]),
+                          mode_transitions, sizeof(mode_transitions) / sizeof(mode_transitions[0]),
+                          event_names, state.mode);
 
 // tools for conversion
-float toFahrenheit(int celcius);
-int toCelcius(float fahrenheit);
+int divide_rounded(int numerator, int denominator);
+int toFahrenheit(int celcius);
+int toCelcius(int fahrenheit);
+
+// diagnostics
+MBED_ALIGN(8) unsigned char diag_stack[MBED_CONF_APP_DIAG_STACK_SIZE];
+Thread t_diag(osPriorityLow, sizeof(diag_stack), diag_stack, "diag");  // low priority thread that reports runtime statistics
+unsigned char diag_queue_buffer[8 * EVENTS_EVENT_SIZE];
+EventQueue diag_queue(sizeof(diag_queue_buffer), diag_queue_buffer);
+
+// telemetry
+#if MBED_CONF_APP_TELEMETRY_ENABLED
+BufferedSerial serial_port(USBTX, USBRX, MBED_CONF_APP_TELEMETRY_BAUD);    // written by the telemetry thread, read by the command thread
+#endif
+mbed_stats_cpu_t last_cpu;      // CPU statistics when the last diagnostics record was sent - only touched by t_diag
+void record_sample(const Reading &reading);
+void send_diagnostics();
+ActivityCounters collect_activity();
+
+// serial commands, each entry gives the argument bytes the command takes (telemetry_record.h)
+int get_thresholds(const uint8_t *args, CommandReply &reply);
+int set_thresholds(const uint8_t *args, CommandReply &reply);
+int get_unit(const uint8_t *args, CommandReply &reply);
+int set_unit(const uint8_t *args, CommandReply &reply);
+void apply_unit(int unit);
+int get_period(const uint8_t *args, CommandReply &reply);
+int set_period(const uint8_t *args, CommandReply &reply);
+int get_stats(const uint8_t *args, CommandReply &reply);
+const CommandEntry commands[] = {
+    {COMMAND_HISTORY,        5, command_history},
+    {COMMAND_GET_THRESHOLDS, 0, get_thresholds},
+    {COMMAND_SET_THRESHOLDS, 8, set_thresholds},
+    {COMMAND_GET_UNIT,       0, get_unit},
+    {COMMAND_SET_UNIT,       1, set_unit},
+    {COMMAND_GET_PERIOD,     1, get_period},
+    {COMMAND_SET_PERIOD,     5, set_period},
+    {COMMAND_STATS,          0, get_stats},
+};
 
 // watchdog
 Watchdog &watchdog = Watchdog::get_instance();
 #define TIMEOUT_MS 5000
+#define KICK_PERIOD 1000ms      // main wakes up at least this often to feed the watchdog
 
-// THREAD 1: main() - initialize program, then poll keypad indefinetly
+// THREAD 1: main() - initialize program, then scan keypad indefinetly
 int main() {
     // printf("------------------ Program Start --------------------\n");
     
-    // configure polling for keypad
+#if !MBED_CONF_APP_LOW_POWER
+    // stay in sleep mode between events, the core wakes faster from it than from stop mode
+    sleep_manager_lock_deep_sleep();
+#endif
+
+    // configure scanning for keypad
     RCC->AHB2ENR |= 0x20; // enable clock Port F
-    /* 
-     *  Turn on output mode for keypad using pins PF_12, PF_13, PF_14,
-     *  and PF_15 by setting their corresponding MODER bits to 01
-     */
-    GPIOF->MODER &= ~(0xaa000000);
-    GPIOF->MODER |= 0x55000000;
-
-    // configure isr on rising signal for each keypad column
-    c0.rise(&isr_c0);
-    c1.rise(&isr_c1);
-    c2.rise(&isr_c2);
-    c3.rise(&isr_c3);
-
-    // enable the interrupts
-    c0.enable_irq();
-    c1.enable_irq();
-    c2.enable_irq();
-    c3.enable_irq();
+    // rows become outputs and are all powered, the column interrupts fire on a rising signal
+    // a column edge only wakes main, so it can wait out a sensor frame instead of stretching its pulses
+    keypad.set_irq_priority(MBED_CONF_APP_SENSOR_MASK_PRIORITY);
+    keypad.set_timing(LONG_PRESS, REPEAT_TIME);
+    keypad.begin();
     
     // start the LCD
-    lcd.begin();
+    display_start(lcd);
     t_lcd.start(callback(update_lcd));
 
     // start the watchdog failsafe
@@ -208,352 +402,724 @@ int main() {
     // start the thread that monitors the climate
     t_monitor.start(callback(monitor_state));
 
+#if MBED_CONF_APP_TELEMETRY_ENABLED
+    // from here on the serial port carries binary telemetry frames, and takes commands
+    telemetry_start(serial_port);
+    command_start(serial_port, commands, sizeof(commands) / sizeof(commands[0]));
+#endif
+
+#if MBED_CONF_APP_DIAG_ENABLED
+#if MBED_CONF_APP_TELEMETRY_ENABLED
+    // text on the same port would break up the frames, so diagnostics go out as telemetry records
+    mbed_stats_cpu_get(&last_cpu);
+    diag_queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_DIAG_REPORT_PERIOD_MS), send_diagnostics);
+#else
+    // report CPU utilization and per-thread runtime over serial
+    diag_start(diag_queue);
+    diag_queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_DIAG_REPORT_PERIOD_MS), callback(&mode_machine, &StateMachine::report));
+    diag_queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_DIAG_REPORT_PERIOD_MS), report_keypad);
+    diag_queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_DIAG_REPORT_PERIOD_MS), callback(&scheduler, &SensorScheduler::report));
+    diag_queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_DIAG_REPORT_PERIOD_MS), report_decode);
+    diag_queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_DIAG_REPORT_PERIOD_MS), IrqWindow::report);
+    diag_queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_DIAG_REPORT_PERIOD_MS), report_energy);
+#endif
+    t_diag.start(callback(&diag_queue, &EventQueue::dispatch_forever));
+#endif
+
+    // everything is allocated by now - from here on any heap allocation is counted (or trapped in static-alloc mode),
+    // C allocations are caught by a periodic check of the heap statistics that runs with or without diagnostics
+    heap_guard_arm();
+    monitor_queue.call_every(HEAP_GUARD_CHECK_PERIOD, heap_guard_check);
+
     while (true) {
         /*
-         *  This is where we poll the keypad for inputs. We do this by enabling power one
-         *  row at a time so that when we complete the circuit and cause an interrupt,
-         *  we can determine which key is pressed since we know the row and column.
+         *  This is where we scan the keypad for inputs. While no key is down we sleep until a
+         *  column interrupt wakes us up, then we power one row at a time and read every column
+         *  so any number of keys can be held at once. Once all keys are released the keypad
+         *  goes back to waiting for an interrupt.
          */
-        
-        GPIOF->ODR &= 0x0;          // clear ODR - disable power to all rows
-        row++;
-        if (row > 3) { row = 0; }
-
-        if (row == 0) {
-            GPIOF->ODR |= 0x1000;   // power PF_12 - connected to: keypad line 8
-        }
-        else if (row == 1) {
-            GPIOF->ODR |= 0x2000;   // power PF_13 - connected to: keypad line 7
-        }
-        else if (row == 2) {
-            GPIOF->ODR |= 0x4000;   // power PF_14 - connected to: keypad line 6
-        }
-        else { //row == 3
-            GPIOF->ODR |= 0x8000;   // power PF_15 - connected to: keypad line 5
+        if (keypad.wait_for_activity(KICK_PERIOD)) {
+            while (keypad.scan()) {
+                watchdog.kick();
+                ThisThread::sleep_for(KEYPAD_SCAN_PERIOD);
+            }
         }
-        
+
         // feed watchdog to prevent it from resetting system
         watchdog.kick();
-
-        // This event queue was configured so the ISRs can tell the polling loop to sleep in order to address bounce
-        queue.dispatch_once();
     }
     return 0;
 }
 
 // THREAD 2: callback t_lcd
+// The user interface is event driven: the keypad scan and t_monitor post events to ui_queue and this
+// thread sleeps in the dispatcher until one arrives, so waiting for the user costs no CPU
 void update_lcd() {
-    while (true) {
-        if (mode == MONITOR || mode == IDLE) {          // display climate information in MONITOR and INPUT mode
-            lcd.clear();
-            update_sensor();
+    mode_machine.start();
+    ui_queue.dispatch_forever();
+}
 
-            if (unit == CELCIUS) {     
-                lcd.print("Temp (C): ");
-                lcd.print(to_string(celcius).c_str());  // access critical resource
-            }
-            else { //unit == FAHRENHEIT
-                lcd.print("Temp (F): ");
-                lcd.print(to_string(fahrenheit).c_str());// access critical resource
+// Purpose: queue an event for the mode state machine, safe to call from an ISR
+void post_event(int event, int arg) {
+    ui_queue.call(dispatch_event, event, arg, us_ticker_read());
+}
 
-            }
-            lcd.setCursor(0, 1);
-            lcd.print("Humidity: ");
-            lcd.print(to_string(humidity).c_str());     // access critical resource
-            
-            thread_sleep_for(1000);
-        }
-        else if (mode == INPUT) { // prompt user for input 
-            input_stage = 0;
-            
-            for (int current_stage = 0; current_stage < 4; current_stage++) {
-                char *prompt = prompts[current_stage];
-                // first we get the input using one of our 4 prompts
-                get_input(prompt, current_stage);
-                // now convert the user inputted string to its proper internal value
-                if (current_stage == 0) { // Prompt: "Minimum Temperatrue?"
-                    if (unit == CELCIUS) {
-                        temp_min_c = atoi(input_str.c_str());
-                        temp_min_f = toFahrenheit(temp_min_c);
-                    }
-                    else {
-                        temp_min_f = atoi(input_str.c_str());
-                        temp_min_c = toCelcius(temp_min_f);
-                    }
-                    
-                }
-                else if (current_stage == 1) { // Prompt: "Maximum Temperature?"
-                    if (unit == CELCIUS) {
-                        temp_max_c = atoi(input_str.c_str());
-                        temp_max_f = toFahrenheit(temp_max_c);
-                    }
-                    else {
-                        temp_max_f = atoi(input_str.c_str());
-                        temp_max_c = toCelcius(temp_max_f);
-                    }
-                }
-                else if (current_stage == 2) { // Prompt: "Minimum Humidity?"
-                    humidity_min = atoi(input_str.c_str());
-                }
-                else if (current_stage == 3) { // Prompt: "Maximum Humidity?"
-                    humidity_max = atoi(input_str.c_str());
-                }
-            }
-            
-            // printf("min temp - c: %d, f: %f\n", temp_min_c, temp_min_f);
-            // printf("max temp - c: %d, f: %f\n", temp_max_c, temp_max_f);
-            // printf("min humidity: %d\n", humidity_min);
-            // printf("max humidity: %d\n", humidity_max);
+// Purpose: run one event through the mode state machine on t_lcd
+void dispatch_event(int event, int arg, uint32_t posted_us) {
+    mode_machine.dispatch(event, arg, posted_us);
+}
 
-            input_stage = -1;
+// Purpose: display the latest climate information, shown in MONITOR and IDLE mode
+void show_status() {
+    char line0[DISPLAY_COLS + 1];   // formatted screen, fixed buffers so we never touch the heap
+    char line1[DISPLAY_COLS + 1];
+    char value[8];
+    Reading reading = state.reading.read();     // consistent copy of the critical resource
 
-            if (validate_input()) {
-                mode = MONITOR;
-            }
-            else {
-                lcd.clear();
-                lcd.print("Invalid Input");
-                lcd.setCursor(0, 1);
-                lcd.print("Please Try Again");
-                thread_sleep_for(3000);
-            } 
+    if (!reading.valid) {   // nothing trustworthy to show, never show stale or garbage values
+        if (SENSOR_COUNT > 1) {
+            snprintf(line1, sizeof(line1), "Check probe P%d", reading.sensor + 1);
+        }
+        else {
+            snprintf(line1, sizeof(line1), "Check the probe");
         }
+        display_show("No Reading", line1, DISPLAY_PRIORITY_STATUS);
+        return;
+    }
+
+    // readings are fixed point tenths, formatted with integer math - the float path of printf allocates
+    if (state.unit == CELCIUS) {     
+        NumericEntry::format_tenths(reading.celcius, value, sizeof(value));
+        snprintf(line0, sizeof(line0), "Temp (C): %s", value);
+    }
+    else { //unit == FAHRENHEIT
+        NumericEntry::format_tenths(toFahrenheit(reading.celcius), value, sizeof(value));
+        snprintf(line0, sizeof(line0), "Temp (F): %s", value);
+    }
+    NumericEntry::format_tenths(reading.humidity, value, sizeof(value));
+    if (SENSOR_COUNT > 1) { // say which probe this is
+        snprintf(line1, sizeof(line1), "Hum: %s%% P%d", value, reading.sensor + 1);
+    }
+    else {
+        snprintf(line1, sizeof(line1), "Humidity: %s", value);
+    }
+    display_show(line0, line1, DISPLAY_PRIORITY_STATUS);
+}
+
+// Purpose: new reading in IDLE mode, refresh the status screen
+void refresh_status(int arg) {
+    show_status();
+}
+
+// Purpose: key event for 'C' outside INPUT mode, flip unit between celcius and fahrenheit
+void toggle_unit(int arg) {
+    state.unit = !state.unit;
+    if (state.mode != ALERT) {
+        show_status();
     }
 }
 
 //////////////////////////////////
-//      ISR - Keypad Input      //
+//         Keypad Input         //
 //////////////////////////////////
 
-// ISR for column 0 - allows user to input values '1', '4', '7', and '*' from keypad
-void isr_c0() {
-    /*
-     *  We only want to accept input when we are in input mode and the 
-     *  input_str value isn't completely filled with user inputted numbers
-     */
-    if (mode == INPUT && input_len < MAX_INPUT) {
-        if (row == 0) {
-            input_str.append("1");
-        }
-        else if (row == 1) {
-            input_str.append("4");
+// Purpose: keypad scan callback on main, called with every debounced press and release and with the long
+// presses and repeats of held keys - what each key does depends on the mode (see mode_transitions)
+void key_event(KeyEvent event) {
+    char key = event.key;
+    if (event.type == KEY_PRESS) {
+        if ('0' <= key && key <= '9') {
+            // digits are only accepted in INPUT mode, the state machine ignores them otherwise
+            post_event(EVENT_DIGIT, key);
         }
-        else if (row == 2) {
-            input_str.append("7");
+        else if (key == 'A' || key == 'B' || key == 'D') {
+            post_event(EVENT_KEY_A + (key - 'A'), 0);
         }
-        input_len++;
-        input_modified = true; // flag to protect critical resource: input_str
+        // 'C', '*' and '#' wait for their release or their long press
+        flash();
     }
-    queue.call(flash, BOUNCE);
-}
-
-// ISR for column 1 - allows user to input the values '2', '5', '8', and '0' from keypad
-void isr_c1() {
-    /*
-     *  We only want to accept input when we are in input mode and the 
-     *  input_str value isn't completely filled with user inputted numbers
-     */
-     if (mode == INPUT && input_len < MAX_INPUT) {
-        if (row == 0) {
-            input_str.append("2");
+    else if (event.type == KEY_RELEASE) {
+        if (event.held) {
+            return;     // the long press already acted
+        }
+        if (key == 'C') {
+            post_event(EVENT_KEY_C, 0);
         }
-        else if (row == 1) {
-            input_str.append("5");
+        else if (key == '*') {
+            post_event(EVENT_SIGN, 0);
         }
-        else if (row == 2) {
-            input_str.append("8");
+        else if (key == '#') {
+            post_event(EVENT_POINT, 0);
         }
-        else if (row == 3) {
-            input_str.append("0");
+    }
+    else if (key == 'C') {
+        if (event.type == KEY_LONG) {
+            post_event(EVENT_CLEAR, 0);
         }
-        input_len++;
-        input_modified = true; // flag to protect critical resource: input_str
     }
-    queue.call(flash, BOUNCE);
+    else if (key == '*' || key == '#') { // KEY_LONG or KEY_REPEAT
+        post_event(EVENT_STEP, key == '*' ? -1 : 1);
+    }
 }
 
-// ISR for column 2 - allows user to input the values '3', '6', and '9' from keypad
-void isr_c2() {
-    /*
-     *  We only want to accept input when we are in input mode and the 
-     *  input_str value isn't completely filled with user inputted numbers
-     */
-    if (mode == INPUT && input_len < MAX_INPUT) {
-        if (row == 0) {
-            input_str.append("3");
-        }
-        else if (row == 1) {
-            input_str.append("6");
-        }
-        else if (row == 2) {
-            input_str.append("9");
-        }
-        input_len++;
-        input_modified = true; // flag to protect critical resource: input_str
+// Purpose: light the LED on a keypad button press, the timeout turns it off again without blocking the scan. In
+// ALERT mode the alarm owns the LED, so a key press does not flash it
+void flash() {
+    if (state.mode == ALERT) {
+        return;
     }
-    queue.call(flash, BOUNCE);
+    set_led(1);
+    led_timeout.attach(led_off, FLASH_TIME);
 }
 
-// ISR for column 3 - allows user to control timer state from keypad
-void isr_c3() {   
-    if (row == 0) {             // key: A
-        if(input_stage != -1) { // updates flag for enters=ing current input value and progressing to the next entry
-            input_stage++;
-        }
+// Purpose: flash timeout ISR - back to the level the mode wants, which follows the buzzer if the alarm started
+// during the flash
+void led_off() {
+    set_led(state.mode == ALERT ? buzzer.read() : 0);
+}
+
+// Purpose: switch the LED and account for its on-time, ISR safe
+void set_led(int on) {
+    led.write(on);
+    led_time.set(on);
+}
+
+// Purpose: switch the buzzer and account for its on-time
+void set_buzzer(int on) {
+    buzzer.write(on);
+    buzzer_time.set(on);
+}
+
+// Purpose: report how often a key combination could not be read because of ghosting
+void report_keypad() {
+    printf("keypad: %lu ghosted scans\n", (unsigned long)keypad.ghost_scans());
+}
+
+////////////////////////////////////
+//      Update Monitor State      //
+////////////////////////////////////
+
+// Purpose: read one sensor in its scheduler slot. A failed read publishes nothing, the scheduler retries it in the
+// sensor's next slot
+int read_sensor(size_t channel) {
+    SensorSample sample;
+    int status = sensors.read(channel, sample);
+    if (status != SENSOR_OK) {
+        return status;  // keep the last good reading until the sensor is given up on
     }
-    else if (row == 1) {        // key: B
-        if(mode != INPUT) { mode = IDLE; }
+    publish_sample(channel, sample);
+    return status;
+}
+
+// Purpose: a good reading is published as one snapshot so readers never see a half updated reading, and the state
+// machine is told there is a new reading - only called on t_monitor
+void publish_sample(size_t channel, const SensorSample &sample) {
+    Reading reading;
+    reading.celcius = sample.celcius;
+    reading.humidity = sample.humidity;
+    reading.sensor = channel;
+    reading.valid = true;
+    state.reading.write(reading);
+    post_event(EVENT_SAMPLE, channel);
+    record_sample(reading);
+
+    // pick the next read from how fast the climate moves and how close it is to the range, unless a period was set
+    uint32_t next = fixed_period_ms[channel];
+    if (next == 0) {
+        next = adaptive_interval_ms(last_sample[channel], sample, state.thresholds.read(),
+                                    SENSOR_INTERVAL.count(), SENSOR_MAX_INTERVAL);
+    }
+    scheduler.set_interval(channel, std::chrono::milliseconds(next));
+    last_sample[channel] = sample;
+}
+
+// Purpose: a sensor failed SENSOR_MAX_RETRIES reads in a row - its last reading is too old to alarm on, so an
+// invalid reading replaces it until a sensor answers again
+void sensor_lost(size_t channel) {
+    Reading reading = {0, 0, (int)channel, false};
+    state.reading.write(reading);
+    post_event(EVENT_SAMPLE, channel);
+    record_sample(reading);
+}
+
+// Purpose: a new range was published - check it on t_monitor, the only thread that touches the sensors
+void range_changed() {
+    if (monitor_queue.call(recheck_range) == 0) {
+        post_event(EVENT_SAMPLE, 0);    // queue full, check the reading there is
     }
-    else if (row == 2) {        // key: C
-        if (mode == INPUT) {    // clear current input entry
-            input_str = "";
-            input_len = 0;
-            input_modified = true; // flag to protect critical resource: input_str
+}
+
+// Purpose: check a new range against readings no older than SENSOR_INTERVAL. A reading slowed down by the adaptive
+// rate can be much older than that, so those sensors are read again out of turn through the scheduler, which counts
+// the read and retries a failed one in its slot; a sensor read within the interval is checked as it is
+void recheck_range() {
+    uint32_t now = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    bool published = false;
+    for (size_t channel = 0; channel < SENSOR_COUNT; channel++) {
+        if (now - last_sample[channel].time_ms <= (uint32_t)SENSOR_INTERVAL.count()) {
+            continue;
+        }
+        if (scheduler.read_now(channel) == SENSOR_OK) {
+            published = true;       // read_sensor() published it
         }
-        else {                  // flip unit between celcius and fahrenheit
-            unit = !unit;
-        } 
     }
-    else if (row == 3) {        // key: D
-        mode = INPUT;
+    if (!published) {
+        post_event(EVENT_SAMPLE, 0);    // every reading was fresh enough, or could not be read again
     }
-    queue.call(flash, BOUNCE);
 }
 
-////////////////////////////////////
-//      Update Monitor State      //
-////////////////////////////////////
+// Purpose: report how cleanly the last DHT frame decoded - a falling confidence means the pulse widths are drifting
+void report_decode() {
+    printf("probe0: bit threshold %u us, decode confidence %u %%\n", probe0.bus().threshold(), probe0.bus().confidence());
+}
 
-// Purpose: update climate information, with critical section protection
-void update_sensor() {
-    sensor.read();
-    celcius = sensor.getCelsius();
-    fahrenheit = sensor.getFahrenheit();
-    humidity = sensor.getHumidity();
+// Purpose: gather what every component has done since boot, for the energy estimate
+ActivityCounters collect_activity() {
+    mbed_stats_cpu_t cpu;
+    mbed_stats_cpu_get(&cpu);
+    ActivityCounters counters;
+    counters.window_ms = cpu.uptime / 1000;
+    counters.sleep_ms = cpu.sleep_time / 1000;
+    counters.stop_ms = cpu.deep_sleep_time / 1000;
+    counters.run_ms = counters.window_ms - counters.sleep_ms - counters.stop_ms;
+    counters.backlight_ms = counters.window_ms;     // the backlight is never switched off
+    counters.buzzer_ms = buzzer_time.on_ms();
+    counters.led_ms = led_time.on_ms();
+    counters.i2c_bytes = display_i2c_bytes();
+    counters.sensor_reads = scheduler.reads();      // recheck_range() reads out of turn through the scheduler too
+    counters.sensors = SENSOR_COUNT;
+    return counters;
 }
 
-// Purpose: enable buzzer and led for given number of milliseconds
-void beep_and_flash(int millisec) {
-    buzzer.write(1);
-    led.write(1);
-    thread_sleep_for(millisec);
-    buzzer.write(0);
-    led.write(0);
+// Purpose: estimate the average current and daily charge from what every component has done since boot
+void report_energy() {
+    energy_report(collect_activity(), energy_model());
 }
 
-// Purpose: Flash LED on interval, used to light LED on keypad button press
-void flash(int millisec) {
-    led.write(1);
-    thread_sleep_for(millisec);
-    led.write(0);
+// Purpose: store a reading in the history and queue it for the telemetry stream, nothing is sent unless telemetry
+// is enabled
+void record_sample(const Reading &reading) {
+    TelemetryRecord record;
+    record.type = TELEMETRY_SAMPLE;
+    record.time_ms = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    record.sample.sensor = reading.sensor;
+    record.sample.valid = reading.valid;
+    record.sample.celcius = reading.celcius;
+    record.sample.humidity = reading.humidity;
+    telemetry_send(record);
+
+    HistoryEntry entry;
+    entry.time_ms = record.time_ms;
+    entry.sensor = record.sample.sensor;
+    entry.valid = record.sample.valid;
+    entry.celcius = record.sample.celcius;
+    entry.humidity = record.sample.humidity;
+    history_append(entry);
+}
+
+// Purpose: send the diagnostics as one telemetry record - CPU use since the last record, heap, sensor reads and
+// the energy estimate
+void send_diagnostics() {
+    mbed_stats_cpu_t cpu;
+    mbed_stats_cpu_get(&cpu);
+    uint64_t uptime = cpu.uptime - last_cpu.uptime;
+    uint64_t idle = cpu.idle_time - last_cpu.idle_time;
+    uint64_t sleep = cpu.sleep_time - last_cpu.sleep_time;
+    uint64_t stop = cpu.deep_sleep_time - last_cpu.deep_sleep_time;
+    last_cpu = cpu;
+    if (uptime == 0) {
+        return;
+    }
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+
+    TelemetryRecord record;
+    record.type = TELEMETRY_DIAG;
+    record.time_ms = (uint32_t)(cpu.uptime / 1000);
+    record.diag.busy = (uptime - idle) * 1000 / uptime;
+    record.diag.sleep = sleep * 1000 / uptime;
+    record.diag.stop = stop * 1000 / uptime;
+    record.diag.heap = heap.current_size;
+    record.diag.reads = scheduler.reads();
+    record.diag.average_ua = energy_average_ua(collect_activity(), energy_model());
+    record.diag.dropped = telemetry_dropped();
+    telemetry_send(record);
 }
 
 // Thread 3: t_monitor callback
-// Purpose: when the device is in monitor mode, trigger alert mode if climate data leaves the user specified range
+// Purpose: read every sensor once per SENSOR_INTERVAL, one at a time in staggered slots so the bit-banged reads
+// never overlap - the state machine decides what a new reading means in each mode
 void monitor_state() {
-    while (true) {
-        while (mode == MONITOR) {
-            update_sensor();
-            if ((unit == FAHRENHEIT && fahrenheit < temp_min_f) || (unit == CELCIUS && celcius < temp_min_c)) {
-                // printf("unit: %d, f: %f < %f, c: %d < %d\n", unit, fahrenheit, temp_min_f, celcius, temp_min_c);
-                lcd.clear();
-                lcd.print("Temperature Too");
-                lcd.setCursor(6, 1);
-                lcd.print("Low");
-                alert();
-            }
-            else if ((unit == FAHRENHEIT && fahrenheit > temp_max_f) || (unit == CELCIUS && celcius > temp_max_c)) {
-                // printf("unit: %d, f: %f > %f, c: %d > %d\n", unit, fahrenheit, temp_max_f, celcius, temp_max_c);
-                lcd.clear();
-                lcd.print("Temperature Too");
-                lcd.setCursor(6, 1);
-                lcd.print("High");
-                alert();
-            }
-            else if (humidity < humidity_min) {
-                lcd.clear();
-                lcd.print("Humidity Too Low");
-                alert();
-            }
-            else if (humidity > humidity_max) {
-                lcd.clear();
-                lcd.print("Humidity Too");
-                lcd.setCursor(6, 1);
-                lcd.print("High");
-                alert();
-            }
-        }
-        thread_sleep_for(1000);
+    scheduler.start(monitor_queue);
+    monitor_queue.dispatch_forever();
+}
+
+// Purpose: new reading in MONITOR mode - show it, and trigger alert mode if it left the user specified range
+void check_range(int arg) {
+    // take one consistent view of the reading and the range for this check
+    Reading reading = state.reading.read();
+    Thresholds range = state.thresholds.read();
+    int celcius = reading.celcius;
+    int humidity = reading.humidity;
+
+    show_status();
+    if (!reading.valid) {
+        return;         // no reading, no alarm - a missing probe must not look like a climate out of range
+    }
+    if (celcius < range.temp_min) {
+        post_event(EVENT_OUT_OF_RANGE, TEMP_TOO_LOW);
+    }
+    else if (celcius > range.temp_max) {
+        post_event(EVENT_OUT_OF_RANGE, TEMP_TOO_HIGH);
+    }
+    else if (humidity < range.humidity_min) {
+        post_event(EVENT_OUT_OF_RANGE, HUMIDITY_TOO_LOW);
+    }
+    else if (humidity > range.humidity_max) {
+        post_event(EVENT_OUT_OF_RANGE, HUMIDITY_TOO_HIGH);
     }
 }
 
-// Purpose: ALERT mode - blink LED and buzzer on interval until B or D is pressed (or the climate data gets back in range)
-void alert() {
-    mode = ALERT;
-    int interval = 1000;
-    while (mode == ALERT) {
-        beep_and_flash(interval);
-        thread_sleep_for(interval);
+// Purpose: tell the user which limit was crossed
+void show_alert(int reason) {
+    TelemetryRecord record;
+    record.type = TELEMETRY_ALERT;
+    record.time_ms = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    record.alert.reason = reason;
+    telemetry_send(record);
+
+    if (reason == TEMP_TOO_LOW) {
+        display_show("Temperature Too", "      Low", DISPLAY_PRIORITY_ALERT);
+    }
+    else if (reason == TEMP_TOO_HIGH) {
+        display_show("Temperature Too", "      High", DISPLAY_PRIORITY_ALERT);
+    }
+    else if (reason == HUMIDITY_TOO_LOW) {
+        display_show("Humidity Too Low", "", DISPLAY_PRIORITY_ALERT);
     }
+    else { //reason == HUMIDITY_TOO_HIGH
+        display_show("Humidity Too", "      High", DISPLAY_PRIORITY_ALERT);
+    }
+}
+
+// Purpose: ALERT mode entry - blink LED and buzzer on interval until B or D is pressed
+void start_alarm() {
+    set_buzzer(1);
+    set_led(1);
+    alarm_event = ui_queue.call_every(ALARM_INTERVAL, toggle_alarm);
+}
+
+// Purpose: ALERT mode exit - silence the buzzer and turn off the LED
+void stop_alarm() {
+    ui_queue.cancel(alarm_event);
+    alarm_event = 0;
+    set_buzzer(0);
+    set_led(0);
+}
 
+// Purpose: switch buzzer and LED between on and off, runs every ALARM_INTERVAL in ALERT mode
+void toggle_alarm() {
+    int on = !buzzer.read();
+    set_buzzer(on);
+    set_led(on);
 }
 
 //////////////////////////////
 //      Getting Input       //
 //////////////////////////////
 
-// Purpose: print the given prompt to the display, and set the LCD cursor to the next line
-void print_prompt(char *prompt) {
-    lcd.clear();
-    lcd.print(prompt);
-    lcd.setCursor(0, 1);
+// Purpose: INPUT mode entry - begin the input wizard at the first prompt
+void start_input() {
+    entered = state.thresholds.read();
+    state.input_stage = 0;
+    begin_prompt(0, 0);
 }
 
-// Purpose: print input prompt along with the currently inputted value
-void get_input(char *prompt, int current_stage) {
-    print_prompt(prompt);
-    input_str = "";
-    input_len = 0;
-    
-    while(input_stage <= current_stage) {
-        // Scynhronization Technique: flag based critical section protection
-        // the flag input_modified is set when our ISR tells the program it detected a new input
-        // it prevents us from printing the input string before it is updated with the user value
-        if (input_modified) {
-            print_prompt(prompt);
-            lcd.print(input_str.c_str());   // critical resource: input_str
-            input_modified = false;
+// Purpose: "Invalid Input" message has been shown long enough, start the wizard over
+void restart_input(int arg) {
+    start_input();
+}
+
+// Purpose: open the entry for the given prompt with the range its value has to be in, previous is the
+// value confirmed at the prompt before it
+void begin_prompt(int stage, int previous) {
+    int min = HUMIDITY_MIN;
+    int max = HUMIDITY_MAX;
+    if (stage < 2) { // temperatures are entered in the unit shown to the user
+        min = TEMP_MIN;
+        max = TEMP_MAX;
+        if (state.unit == FAHRENHEIT) {
+            min = toFahrenheit(min);
+            max = toFahrenheit(max);
         }
     }
+    if (stage == 1 || stage == 3) { // a maximum can not be below its minimum
+        min = previous;
+    }
+    entry.begin(min, max);
+    print_prompt(prompts[stage]);
+}
+
+// Purpose: key event for '0'-'9', add the digit to the current entry and show it
+void enter_digit(int digit) {
+    if (state.input_stage < 0 || !entry.digit(digit - '0')) {
+        return;     // a digit that would take the entry out of range is refused
+    }
+    show_entry();
+}
+
+// Purpose: short press of '*' in INPUT mode, flip the sign of the current entry
+void toggle_sign(int arg) {
+    if (state.input_stage < 0 || !entry.sign()) {
+        return;
+    }
+    show_entry();
+}
+
+// Purpose: short press of '#' in INPUT mode, start the tenths of the current entry
+void decimal_point(int arg) {
+    if (state.input_stage < 0 || !entry.point()) {
+        return;
+    }
+    show_entry();
+}
+
+// Purpose: short press of 'C' in INPUT mode, remove the last digit of the current entry
+void backspace_input(int arg) {
+    if (state.input_stage < 0) {
+        return;
+    }
+    entry.backspace();
+    show_entry();
+}
+
+// Purpose: long press of 'C' in INPUT mode, clear the current entry
+void clear_input(int arg) {
+    int stage = state.input_stage;
+    if (stage < 0) {
+        return;
+    }
+    entry.clear();
+    print_prompt(prompts[stage]);
+}
+
+// Purpose: '*' or '#' held in INPUT mode, scroll the current entry down or up by one on every repeat
+void step_input(int delta) {
+    if (state.input_stage < 0) {
+        return;
+    }
+    entry.add(delta * 10);
+    show_entry();
+}
+
+// Purpose: key event for 'A', store the current entry and move on to the next prompt
+void confirm_input(int arg) {
+    int stage = state.input_stage;
+    if (stage < 0) {
+        return;
+    }
+    if (!entry.in_range()) {
+        show_range();
+        return;
+    }
+    store_input(stage);
+    stage++;
+    if (stage < 4) {
+        state.input_stage = stage;
+        begin_prompt(stage, entry.value());
+    }
+    else {
+        finish_input();
+    }
 }
 
-// Purpose: ensure all entered values are valid ranges that the DHT11 is capable of sensing (0-50 celcius, 20%-95% RH) 
-bool validate_input() {
-    bool valid_temp_c = false;
-    if (TEMP_MIN_C <= temp_min_c && temp_min_c <= temp_max_c && temp_max_c <= TEMP_MAX_C) {
-        valid_temp_c = true;
+// Purpose: convert the confirmed entry to its internal value (tenths of a degree Celcius or %RH) for the given prompt
+void store_input(int stage) {
+    int value = entry.value();
+    if (stage < 2 && state.unit == FAHRENHEIT) {
+        value = toCelcius(value);
     }
-    bool valid_temp_f = false;
-    if (TEMP_MIN_F <= temp_min_f && temp_min_f <= temp_max_f && temp_max_f <= TEMP_MAX_F) {
-        valid_temp_f = true;
+    if (stage == 0) { // Prompt: "Minimum Temperatrue?"
+        entered.temp_min = value;
+    }
+    else if (stage == 1) { // Prompt: "Maximum Temperature?"
+        entered.temp_max = value;
+    }
+    else if (stage == 2) { // Prompt: "Minimum Humidity?"
+        entered.humidity_min = value;
+    }
+    else if (stage == 3) { // Prompt: "Maximum Humidity?"
+        entered.humidity_max = value;
+    }
+}
+
+// Purpose: all four values entered - publish them and start monitoring, or ask the user to try again
+void finish_input() {
+    state.input_stage = -1;
+
+    if (validate_input(entered)) {
+        state.thresholds.write(entered);
+        post_event(EVENT_INPUT_VALID, 0);
+        range_changed();
+    }
+    else {
+        post_event(EVENT_INPUT_INVALID, 0);
+    }
+}
+
+// Purpose: tell the user the range was invalid, and start over once they have had time to read it
+void show_invalid(int arg) {
+    display_show("Invalid Input", "Please Try Again", DISPLAY_PRIORITY_PROMPT);
+    ui_queue.call_in(3000ms, post_event, EVENT_INPUT_RETRY, 0);
+}
+
+// Purpose: show the prompt with the current entry as typed
+void show_entry() {
+    char line1[DISPLAY_COLS + 1];
+    entry.format(line1, sizeof(line1));
+    display_show(prompts[state.input_stage], line1, DISPLAY_PRIORITY_PROMPT);
+}
+
+// Purpose: the entry could not be confirmed, show the range it has to be in - the next key shows the entry again
+void show_range() {
+    char min[8];
+    char max[8];
+    char line1[DISPLAY_COLS + 1];
+    NumericEntry::format_tenths(entry.min(), min, sizeof(min));
+    NumericEntry::format_tenths(entry.max(), max, sizeof(max));
+    snprintf(line1, sizeof(line1), "%s to %s", min, max);
+    display_show(prompts[state.input_stage], line1, DISPLAY_PRIORITY_PROMPT);
+}
+
+// Purpose: print the given prompt to the display, with an empty entry on the next line
+void print_prompt(char *prompt) {
+    display_show(prompt, "", DISPLAY_PRIORITY_PROMPT);
+}
+
+// Purpose: ensure all entered values form valid ranges within the supported limits (-40.0-80.0 celcius, 0-100% RH)
+bool validate_input(const Thresholds &entered) {
+    bool valid_temp = false;
+    if (TEMP_MIN <= entered.temp_min && entered.temp_min <= entered.temp_max && entered.temp_max <= TEMP_MAX) {
+        valid_temp = true;
     }
     bool valid_humidity = false;
-    if (HUMIDITY_MIN <= humidity_min && humidity_min <= humidity_max && humidity_max <= HUMIDITY_MAX) {
+    if (HUMIDITY_MIN <= entered.humidity_min && entered.humidity_min <= entered.humidity_max && entered.humidity_max <= HUMIDITY_MAX) {
         valid_humidity = true;
     }
-    return (valid_humidity & valid_temp_c & valid_temp_f);
+    return (valid_humidity & valid_temp);
+}
+
+/////////////////////////////////////
+//         Serial Commands         //
+/////////////////////////////////////
+
+// Purpose: COMMAND_GET_THRESHOLDS - reply with the range, in tenths of a degree Celcius and of a percent RH
+int get_thresholds(const uint8_t *args, CommandReply &reply) {
+    Thresholds range = state.thresholds.read();
+    reply.values[0] = range.temp_min;
+    reply.values[1] = range.temp_max;
+    reply.values[2] = range.humidity_min;
+    reply.values[3] = range.humidity_max;
+    reply.count = 4;
+    return COMMAND_OK;
+}
+
+// Purpose: COMMAND_SET_THRESHOLDS - publish a new range if it is valid, under the same rules as the keypad wizard,
+// and have the state machine check the latest reading against it straight away
+int set_thresholds(const uint8_t *args, CommandReply &reply) {
+    Thresholds range;
+    range.temp_min = (int16_t)frame_get_u16(args);
+    range.temp_max = (int16_t)frame_get_u16(args + 2);
+    range.humidity_min = (int16_t)frame_get_u16(args + 4);
+    range.humidity_max = (int16_t)frame_get_u16(args + 6);
+    if (!validate_input(range)) {
+        return COMMAND_ERROR_RANGE;
+    }
+    state.thresholds.write(range);
+    range_changed();
+    return COMMAND_OK;
+}
+
+// Purpose: COMMAND_GET_UNIT - reply with the unit shown on the LCD
+int get_unit(const uint8_t *args, CommandReply &reply) {
+    reply.values[0] = state.unit;
+    reply.count = 1;
+    return COMMAND_OK;
+}
+
+// Purpose: COMMAND_SET_UNIT - change the unit shown on the LCD, on t_lcd like a key press would
+int set_unit(const uint8_t *args, CommandReply &reply) {
+    if (args[0] != CELCIUS && args[0] != FAHRENHEIT) {
+        return COMMAND_ERROR_RANGE;
+    }
+    return ui_queue.call(apply_unit, (int)args[0]) ? COMMAND_OK : COMMAND_ERROR_BUSY;
+}
+
+// Purpose: change the unit and redraw the status screen if it is up
+void apply_unit(int unit) {
+    state.unit = unit;
+    if (state.mode == IDLE || state.mode == MONITOR) {
+        show_status();
+    }
+}
+
+// Purpose: COMMAND_GET_PERIOD - reply with how often a sensor is read now, and the fixed period (0 when adaptive)
+int get_period(const uint8_t *args, CommandReply &reply) {
+    if (args[0] >= SENSOR_COUNT) {
+        return COMMAND_ERROR_RANGE;
+    }
+    reply.values[0] = scheduler.interval(args[0]).count();
+    reply.values[1] = fixed_period_ms[args[0]];
+    reply.count = 2;
+    return COMMAND_OK;
+}
+
+// Purpose: COMMAND_SET_PERIOD - read a sensor at a fixed period between SENSOR_INTERVAL and SENSOR_MAX_INTERVAL,
+// or with 0 go back to picking the period from the climate after each read
+int set_period(const uint8_t *args, CommandReply &reply) {
+    uint32_t period = frame_get_u32(args + 1);
+    if (args[0] >= SENSOR_COUNT ||
+        (period != 0 && (period < (uint32_t)SENSOR_INTERVAL.count() || period > SENSOR_MAX_INTERVAL))) {
+        return COMMAND_ERROR_RANGE;
+    }
+    fixed_period_ms[args[0]] = period;
+    if (period != 0) {
+        scheduler.set_interval(args[0], std::chrono::milliseconds(period));
+    }
+    return COMMAND_OK;
+}
+
+// Purpose: COMMAND_STATS - reply with uptime, sensor reads, dropped telemetry, commands handled, the worst command
+// latency and heap use
+int get_stats(const uint8_t *args, CommandReply &reply) {
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    reply.values[0] = Kernel::Clock::now().time_since_epoch().count() / 1000;
+    reply.values[1] = scheduler.reads();
+    reply.values[2] = telemetry_dropped();
+    reply.values[3] = command_count();
+    reply.values[4] = command_worst_us();
+    reply.values[5] = heap.current_size;
+    reply.count = 6;
+    return COMMAND_OK;
 }
 
 /////////////////////////////////////
 //      Tools for Conversion       //
 /////////////////////////////////////
 
-// Purpose: convert celcius to fahrenheit
-float toFahrenheit(int celcius) {
-    return celcius * 1.8 + 32;
+// Purpose: divide, rounding to the nearest integer instead of towards zero
+int divide_rounded(int numerator, int denominator) {
+    int half = denominator / 2;
+    return (numerator + (numerator >= 0 ? half : -half)) / denominator;
+}
+
+// Purpose: convert tenths of a degree celcius to tenths of a degree fahrenheit
+int toFahrenheit(int celcius) {
+    return divide_rounded(celcius * 9, 5) + 320;
 }
 
-// Purpose: convert fahrenheit to celcius
-int toCelcius(float fahrenheit) {
-    return (fahrenheit - 32) / 1.8;
+// Purpose: convert tenths of a degree fahrenheit to tenths of a degree celcius
+int toCelcius(int fahrenheit) {
+    return divide_rounded((fahrenheit - 320) * 5, 9);
 }
@@ -8,27 +8,17 @@
 
 
 #include "DHT.h"
- 
-DHT11::DHT11(PinName const &p) : _pin(p) {
+
+DHTBus::DHTBus(PinName const &p) : _pin(p), _threshold(DHT_NOMINAL_THRESHOLD), _confidence(0) {
     // Set creation time so we can make 
     // sure we pause at least 1 second for 
     // startup.
     _timer.start();
-    _temperature = 0; //default unit of Celcius 
-    _humidity = 0;
 }
 
-int DHT11::read() {
-    // can not read more frequent than every 2 seconds
-  
+int DHTBus::read_frame(int start_ms, uint8_t bits[5]) {
     // BUFFER TO RECEIVE
-    uint8_t bits[5]; // DHT11 is a 40 bit signal, grouped in 5 bytes, each byte has own purpose
-    uint8_t cnt = 7; //byte bit tracker
-    uint8_t idx = 0; // bit set tracking
-    //read in MSB to LSB 
- 
-    // EMPTY BUFFER
-    for (int i=0; i< 5; i++) bits[i] = 0;
+    uint8_t widths[DHT_BITS]; // length of each high pulse in us, decoded once the whole frame is in
     
     // Verify sensor settled after boot
     while(_timer.elapsed_time().count() < 1500) {}
@@ -37,7 +27,10 @@ int DHT11::read() {
     // Notify it we are ready to read
     _pin.output();
     _pin = 0;
-    thread_sleep_for(18);
+    thread_sleep_for(start_ms);
+
+    // from here the sensor sets the pace, hold off the keypad and thread switches until the frame is in
+    IrqWindow window(DHT_MASK_PRIORITY);
     _pin = 1;
     wait_us(40);
     _pin.input();
@@ -51,48 +44,69 @@ int DHT11::read() {
     while(_pin == 1)
         if (loopCnt-- == 0) return DHTLIB_ERROR_TIMEOUT;
  
-    // READ OUTPUT - 40 BITS => 5 BYTES or TIMEOUT
-    for (int i=0; i<40; i++)
+    // READ OUTPUT - 40 PULSE WIDTHS or TIMEOUT
+    for (int i=0; i<DHT_BITS; i++)
     {
         loopCnt = 10000;
         while(_pin == 0)
             if (loopCnt-- == 0) return DHTLIB_ERROR_TIMEOUT;
  
-        //unsigned long t = micros();
-        Timer t;
-        t. start();
+        uint32_t rise = us_ticker_read();
  
         loopCnt = 10000;
         while(_pin == 1) //track how long value is 1
             if (loopCnt-- == 0) return DHTLIB_ERROR_TIMEOUT;
 
-        //26-30us is 0, ~70us is 1, 40 is a good sample point
-        if (t.elapsed_time().count() > 40) bits[idx] |= (1 << cnt);
-        if (cnt == 0)   // next byte?
-        {
-            cnt = 7;    // restart at MSB
-            idx++;      // next byte!
-        }
-        else cnt--;
+        uint32_t width = us_ticker_read() - rise;
+        widths[i] = width > 255 ? 255 : width;
     }
+
+    DHTFrame frame;
+    bool clear = dht_decode(widths, frame);
+    for (int i=0; i<5; i++) bits[i] = frame.bits[i];
+    _threshold = frame.threshold;
+    _confidence = frame.confidence;
+    // a pulse on the cutoff is a bit that may be wrong, counted with the checksum errors
+    if (!clear) return DHTLIB_ERROR_CHECKSUM;
+    return DHTLIB_OK;
+}
+
+DHT11::DHT11(PinName const &p) : _bus(p) {
+}
+
+int DHT11::read_sample(SensorSample &sample) {
+    // can not read more frequent than every 2 seconds, ClimateSensor::read() refuses earlier reads
+  
+    // BUFFER TO RECEIVE
+    uint8_t bits[5]; // DHT11 is a 40 bit signal, grouped in 5 bytes, each byte has own purpose
+    int status = _bus.read_frame(18, bits); // the DHT11 needs at least 18 ms to wake up
+    if (status != DHTLIB_OK) return status;
  
-    // WRITE TO RIGHT VARS
-    // as bits[1] and bits[3] are allways zero they are omitted in formulas.
-    _humidity    = bits[0];
-    _temperature = bits[2];
-    uint8_t sum = bits[0] + bits[2];  
- 
-    if (bits[4] != sum) return DHTLIB_ERROR_CHECKSUM;
+    // WRITE TO RIGHT VARS - only once the whole frame is validated, the last good sample is kept on error
+    if (!dht11_values(bits, sample.celcius, sample.humidity)) return DHTLIB_ERROR_CHECKSUM;
     return DHTLIB_OK;
 }
  
 float DHT11::getFahrenheit() { //performs C to F conversion
-    return((_temperature * 1.8) + 32);
+    return((sample().celcius * 0.18) + 32);
 }
  
-int DHT11::getCelsius() {
-    return(_temperature);
+int DHT11::getCelsius() { // whole degrees, sample() has the tenths
+    return(sample().celcius / 10);
 }
 int DHT11::getHumidity() {
-    return(_humidity);
-}
\ No newline at end of file
+    return(sample().humidity / 10);
+}
+
+DHT22::DHT22(PinName const &p) : _bus(p) {
+}
+
+int DHT22::read_sample(SensorSample &sample) {
+    // BUFFER TO RECEIVE
+    uint8_t bits[5]; // humidity high, low, temperature high, low, checksum
+    int status = _bus.read_frame(2, bits); // a long start signal can make the DHT22 miss its reply, 1-10 ms
+    if (status != DHTLIB_OK) return status;
+
+    if (!dht22_values(bits, sample.celcius, sample.humidity)) return DHTLIB_ERROR_CHECKSUM;
+    return DHTLIB_OK;
+}
@@ -9,10 +9,74 @@
 #define DHT11_H
  
 #include "mbed.h"
+#include "climate_sensor.h"
+#include "dht_frame.h"
+#include "irq_window.h"
  
-#define DHTLIB_OK                0
-#define DHTLIB_ERROR_CHECKSUM   -1
-#define DHTLIB_ERROR_TIMEOUT    -2
+#define DHTLIB_OK                SENSOR_OK
+#define DHTLIB_ERROR_CHECKSUM    SENSOR_ERROR_CHECKSUM
+#define DHTLIB_ERROR_TIMEOUT     SENSOR_ERROR_TIMEOUT
+
+// NVIC priority masked, with every lower one, while a frame is timed (see irq_window.h), 0 leaves frames unmasked
+#ifdef MBED_CONF_APP_SENSOR_MASK_PRIORITY
+#define DHT_MASK_PRIORITY MBED_CONF_APP_SENSOR_MASK_PRIORITY
+#else
+#define DHT_MASK_PRIORITY 0
+#endif
+
+/** Single wire bus shared by the DHT11 and DHT22 drivers.
+ *
+ * Bits are sent as high pulses, ~27 us for a 0 and ~70 us for a 1. Instead
+ * of comparing each pulse against a fixed cutoff as it arrives, all 40 pulse
+ * widths are measured first and then decoded by dht_decode() (dht_frame.h),
+ * which places the cutoff between the two clusters of widths. The confidence
+ * of the last decode says how far the closest pulse was from the cutoff.
+ *
+ * The ~4 ms from the end of the start signal to the last bit are timed
+ * inside an IrqWindow, so interrupts at DHT_MASK_PRIORITY and below wait
+ * for the frame instead of stretching its pulses.
+ */
+class DHTBus
+{
+public:
+    /** Construct the bus.
+     *
+     * @param pin PinName for the sensor pin.
+     */
+    DHTBus(PinName const &p);
+
+    /** Send the start signal and read one frame.
+     *
+     * @param start_ms how long the start signal holds the line low
+     * @param bits receives the five bytes of the frame
+     * @returns
+     *   0 on success, DHTLIB_ERROR_TIMEOUT if the sensor stopped answering,
+     *   DHTLIB_ERROR_CHECKSUM if a pulse was too close to the cutoff to tell its bit.
+     */
+    int read_frame(int start_ms, uint8_t bits[5]);
+
+    /** Get the cutoff chosen for the last frame.
+     *
+     * @returns
+     *   pulse width in us, longer pulses were read as 1
+     */
+    uint8_t threshold() const { return _threshold; }
+
+    /** Get the confidence of the last frame's decode.
+     *
+     * @returns
+     *   0 (a pulse sat on the cutoff) to 100 (every pulse at least half the nominal gap away)
+     */
+    uint8_t confidence() const { return _confidence; }
+
+private:
+    /// pin to read the sensor info on
+    DigitalInOut _pin;
+    /// times startup (must settle for at least a second)
+    Timer _timer;
+    uint8_t _threshold;
+    uint8_t _confidence;
+};
  
 /** Class for the DHT11 sensor.
  * 
@@ -29,22 +93,36 @@
  *     pc.printf("T: %f, H: %d\r\n", sensor.getFahrenheit(), sensor.getHumidity());
  * }
  * @endcode
+ *
+ * A ClimateSensor driver: read() updates the sample, the getters below are
+ * kept for code written against the original library.
  */
-class DHT11
+class DHT11 : public ClimateSensor<DHT11>
 {
 public:
+    /// the DHT11 may be read once per second, 2 seconds leaves margin for self heating
+    static constexpr uint32_t MIN_INTERVAL_MS = 2000;
+
     /** Construct the sensor object.
      *
      * @param pin PinName for the sensor pin.
      */
     DHT11(PinName const &p);
     
-    /** Update the humidity and temp from the sensor.
+    /** Read the humidity and temp from the sensor, called by read().
      *
+     * @param sample receives the values in tenths, 0 - 50.0 C and 20.0 - 90.0 %RH
      * @returns
      *   0 on success, otherwise error.
      */
-    int read();
+    int read_sample(SensorSample &sample);
+
+    /** Get the bus, for the decode statistics of the last frame.
+     *
+     * @returns
+     *   the sensor's bus
+     */
+    const DHTBus &bus() const { return _bus; }
     
     /** Get the temp(f) from the saved object.
      *
@@ -68,14 +146,54 @@ public:
     int getHumidity();
  
 private:
-    /// percentage of humidity
-    int _humidity;
-    /// celsius
-    int _temperature;
-    /// pin to read the sensor info on
-    DigitalInOut _pin;
-    /// times startup (must settle for at least a second)
-    Timer _timer;
+    DHTBus _bus;
+};
+
+/** Class for the DHT22 (AM2302) sensor.
+ *
+ * Same single wire protocol as the DHT11, but humidity and temperature are
+ * 16 bit values in tenths and the temperature can be negative.
+ *
+ * Example:
+ * @code
+ * DHT22 sensor(PG_1);
+ *
+ * int main() {
+ *     if (sensor.read() == DHTLIB_OK) {
+ *         printf("T: %d tenths C, H: %d tenths %%\r\n", sensor.sample().celcius, sensor.sample().humidity);
+ *     }
+ * }
+ * @endcode
+ */
+class DHT22 : public ClimateSensor<DHT22>
+{
+public:
+    /// the DHT22 may be read once every 2 seconds
+    static constexpr uint32_t MIN_INTERVAL_MS = 2000;
+
+    /** Construct the sensor object.
+     *
+     * @param pin PinName for the sensor pin.
+     */
+    DHT22(PinName const &p);
+
+    /** Read the humidity and temp from the sensor, called by read().
+     *
+     * @param sample receives the values in tenths, -40.0 to 80.0 C and 0 to 100.0 %RH
+     * @returns
+     *   0 on success, otherwise error.
+     */
+    int read_sample(SensorSample &sample);
+
+    /** Get the bus, for the decode statistics of the last frame.
+     *
+     * @returns
+     *   the sensor's bus
+     */
+    const DHTBus &bus() const { return _bus; }
+
+private:
+    DHTBus _bus;
 };
  
 #endif
\ No newline at end of file
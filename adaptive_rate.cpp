@@ -0,0 +1,52 @@
+// Adaptive sampling period for the climate sensors
+
+#include "adaptive_rate.h"
+
+// Purpose: distance in tenths from a value to the nearer limit of its range, 0 once it is outside
+static int distance(int value, int low, int high) {
+    if (value <= low || value >= high) {
+        return 0;
+    }
+    return value - low < high - value ? value - low : high - value;
+}
+
+// Purpose: time in ms until a quantity that moved by change in elapsed_ms covers distance, divided over
+// ADAPTIVE_LEAD reads - max_ms if it did not move
+static uint32_t lead_time(int distance, int change, uint32_t elapsed_ms, uint32_t max_ms) {
+    if (change < 0) {
+        change = -change;
+    }
+    if (change == 0) {
+        return max_ms;
+    }
+    uint64_t lead = (uint64_t)distance * elapsed_ms / change / ADAPTIVE_LEAD;
+    return lead < max_ms ? (uint32_t)lead : max_ms;
+}
+
+uint32_t adaptive_interval_ms(const SensorSample &previous, const SensorSample &current, const Thresholds &range,
+                              uint32_t min_ms, uint32_t max_ms) {
+    if (previous.time_ms == 0) {
+        return min_ms;      // no rate of change yet
+    }
+    int temp_distance = distance(current.celcius, range.temp_min, range.temp_max);
+    int humidity_distance = distance(current.humidity, range.humidity_min, range.humidity_max);
+    if (temp_distance <= ADAPTIVE_NEAR || humidity_distance <= ADAPTIVE_NEAR) {
+        return min_ms;
+    }
+
+    int temp_change = current.celcius - previous.celcius;
+    int humidity_change = current.humidity - previous.humidity;
+    if (temp_change >= ADAPTIVE_STEP || temp_change <= -ADAPTIVE_STEP ||
+        humidity_change >= ADAPTIVE_STEP || humidity_change <= -ADAPTIVE_STEP) {
+        return min_ms;
+    }
+
+    // whichever quantity would reach its limit first sets the pace
+    uint32_t elapsed_ms = current.time_ms - previous.time_ms;
+    uint32_t interval = lead_time(temp_distance, temp_change, elapsed_ms, max_ms);
+    uint32_t humidity_interval = lead_time(humidity_distance, humidity_change, elapsed_ms, max_ms);
+    if (humidity_interval < interval) {
+        interval = humidity_interval;
+    }
+    return interval < min_ms ? min_ms : interval;
+}
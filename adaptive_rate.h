@@ -0,0 +1,39 @@
+// Adaptive sampling period for the climate sensors
+//
+// A stable room far from its limits does not need a reading every 2 seconds,
+// but a door opening next to a limit does. After each good read the next
+// read is scheduled from how fast the climate is moving and how far it is
+// from the user's range: at the current rate of change a limit is never
+// reached in fewer than ADAPTIVE_LEAD reads, a jump or a reading close to a
+// limit goes straight back to the shortest period, and a steady climate far
+// from both limits is read at the longest one.
+//
+// This file only depends on the C library so the host tools build it too.
+
+#ifndef ADAPTIVE_RATE_H
+#define ADAPTIVE_RATE_H
+
+#include "climate_types.h"
+#include <stdint.h>
+
+#define ADAPTIVE_NEAR 20        // tenths, a reading this close to a limit (2.0 C or 2.0 %RH) is read as often as possible
+#define ADAPTIVE_STEP 20        // tenths, a change this big between two reads is a transient, read as often as possible
+#define ADAPTIVE_LEAD 4         // reads taken, at the current rate of change, before a limit could be reached
+
+/** Choose the time until a sensor's next read.
+ *
+ * A pure function of its arguments, so it can be replayed off target
+ * against recorded samples.
+ *
+ * @param previous the sensor's last good sample before current, time_ms 0 if there is none
+ * @param current the sample just read
+ * @param range the user's limits, in the same tenths as the samples
+ * @param min_ms shortest period, the sensor's minimum interval
+ * @param max_ms longest period
+ * @returns
+ *   milliseconds until the next read, min_ms to max_ms
+ */
+uint32_t adaptive_interval_ms(const SensorSample &previous, const SensorSample &current, const Thresholds &range,
+                              uint32_t min_ms, uint32_t max_ms);
+
+#endif
@@ -0,0 +1,241 @@
+// Compile-time climate sensor interface
+//
+// Every sensor driver derives from ClimateSensor<Driver> and implements
+// read_sample(). The base class turns that into the common API, and
+// SensorArray holds a fixed list of drivers of different types as channels.
+// The type of every channel is known at compile time, so each call goes
+// straight to the driver: there are no virtual functions, no vtables and no
+// heap.
+//
+// The base class also owns the read cadence: a read within the driver's
+// minimum interval of the previous one never reaches the bus, and get()
+// answers from the last good sample while it is fresh enough, so callers
+// can ask as often as they like without heating the sensor.
+
+#ifndef CLIMATE_SENSOR_H
+#define CLIMATE_SENSOR_H
+
+#include "mbed.h"
+#include "climate_types.h"
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// status returned by read(), the DHT library uses the same values
+#define SENSOR_OK 0
+#define SENSOR_ERROR_CHECKSUM -1
+#define SENSOR_ERROR_TIMEOUT -2
+#define SENSOR_ERROR_BUS -3         // the sensor did not acknowledge on its bus
+#define SENSOR_ERROR_CHANNEL -4     // no sensor on that channel
+#define SENSOR_ERROR_INTERVAL -5    // read refused, the driver's minimum interval has not passed since the last one
+
+#define SENSOR_INTERVAL_JITTER_MS 20    // a periodic read may run this much early after a late previous one
+
+/** Base class for climate sensor drivers.
+ *
+ * A driver implements:
+ * @code
+ * class MySensor : public ClimateSensor<MySensor> {
+ * public:
+ *     static constexpr uint32_t MIN_INTERVAL_MS = 2000;    // shortest time between two reads
+ *     int read_sample(SensorSample &sample);               // fill sample, return SENSOR_OK or an error
+ * };
+ * @endcode
+ *
+ * @tparam Driver the class deriving from this one
+ */
+template <typename Driver>
+class ClimateSensor {
+public:
+    /** Take a new sample from the sensor, kept until the next successful read.
+     *
+     * The bus is only touched if the driver's minimum interval has passed
+     * since the previous read, successful or not.
+     *
+     * @returns
+     *   SENSOR_OK on success, otherwise an error and the last good sample is kept
+     */
+    int read() {
+        static_assert(Driver::MIN_INTERVAL_MS > SENSOR_INTERVAL_JITTER_MS, "minimum interval shorter than its jitter");
+        uint32_t now = now_ms();
+        if (_attempted && now - _attempt_ms < Driver::MIN_INTERVAL_MS - SENSOR_INTERVAL_JITTER_MS) {
+            return SENSOR_ERROR_INTERVAL;
+        }
+        _attempted = true;
+        _attempt_ms = now;
+
+        SensorSample sample;
+        int status = static_cast<Driver *>(this)->read_sample(sample);
+        if (status == SENSOR_OK) {
+            sample.time_ms = now;
+            _sample = sample;
+            _valid = true;
+        }
+        return status;
+    }
+
+    /** Get a sample no older than max_age, reading the sensor only if the last good one is older.
+     *
+     * @param max_age oldest sample the caller accepts
+     * @param sample receives the new sample, or the last good one if the sensor could not be read
+     * @returns
+     *   SENSOR_OK if sample is no older than max_age, otherwise the error of the read that was tried
+     */
+    int get(std::chrono::milliseconds max_age, SensorSample &sample) {
+        int status = SENSOR_OK;
+        if (age_ms() > (uint32_t)max_age.count()) {
+            status = read();
+        }
+        sample = _sample;
+        return status;
+    }
+
+    /** Get the last good sample.
+     *
+     * @returns
+     *   temperature and humidity in tenths, zero before the first good read
+     */
+    const SensorSample &sample() const {
+        return _sample;
+    }
+
+    /** Get the age of the last good sample.
+     *
+     * @returns
+     *   milliseconds since the sample was read, UINT32_MAX before the first good read
+     */
+    uint32_t age_ms() const {
+        return _valid ? now_ms() - _sample.time_ms : UINT32_MAX;
+    }
+
+    /** Get the shortest time the driver allows between two reads.
+     *
+     * @returns
+     *   minimum read interval in milliseconds
+     */
+    static constexpr uint32_t min_interval_ms() {
+        return Driver::MIN_INTERVAL_MS;
+    }
+
+protected:
+    ClimateSensor() : _sample{0, 0, 0}, _attempt_ms(0), _attempted(false), _valid(false) {
+    }
+    ~ClimateSensor() = default;     // never deleted through the base, so no virtual destructor
+
+private:
+    // Kernel clock time in milliseconds, wraps after 49 days which the unsigned differences tolerate
+    static uint32_t now_ms() {
+        return (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    }
+
+    SensorSample _sample;
+    uint32_t _attempt_ms;   // time of the last read that reached the bus
+    bool _attempted;
+    bool _valid;            // _sample holds a good reading
+};
+
+/** Fixed set of climate sensors of mixed types, addressed by channel number.
+ *
+ * Example:
+ * @code
+ * DHT11 probe0(PG_0);
+ * DHT22 probe1(PG_1);
+ * SHT3x probe2(PB_9, PB_8);
+ * SensorArray<DHT11, DHT22, SHT3x> sensors(probe0, probe1, probe2);
+ *
+ * SensorSample sample;
+ * if (sensors.read(1, sample) == SENSOR_OK) { ... }     // reads probe1 through DHT22::read_sample()
+ * if (sensors.get(2, 5000ms, sample) == SENSOR_OK) { ... }  // probe2's last sample, read again if older than 5 s
+ * @endcode
+ *
+ * @tparam Sensors driver type of each channel, in channel order
+ */
+template <typename... Sensors>
+class SensorArray {
+    static_assert(sizeof...(Sensors) > 0, "a sensor array needs at least one sensor");
+
+public:
+    /** Construct the array over existing drivers.
+     *
+     * @param sensors one driver per channel, they must outlive the array
+     */
+    explicit SensorArray(Sensors &... sensors) : _sensors(sensors...) {
+    }
+
+    /** Get the number of channels.
+     *
+     * @returns
+     *   number of sensors in the array
+     */
+    static constexpr size_t size() {
+        return sizeof...(Sensors);
+    }
+
+    /** Get the longest minimum read interval of all channels.
+     *
+     * @returns
+     *   shortest time in milliseconds every channel can be read in
+     */
+    static constexpr uint32_t min_interval_ms() {
+        return max_interval<Sensors...>();
+    }
+
+    /** Read one channel.
+     *
+     * @param channel channel number, 0 to size() - 1
+     * @param sample receives the new sample on success
+     * @returns
+     *   SENSOR_OK on success, otherwise an error
+     */
+    int read(size_t channel, SensorSample &sample) {
+        return visit<0>(channel, [&sample](auto &sensor) {
+            int status = sensor.read();
+            sample = sensor.sample();
+            return status;
+        });
+    }
+
+    /** Get a sample of one channel no older than max_age, see ClimateSensor::get().
+     *
+     * @param channel channel number, 0 to size() - 1
+     * @param max_age oldest sample the caller accepts
+     * @param sample receives the sample
+     * @returns
+     *   SENSOR_OK if sample is no older than max_age, otherwise an error
+     */
+    int get(size_t channel, std::chrono::milliseconds max_age, SensorSample &sample) {
+        return visit<0>(channel, [max_age, &sample](auto &sensor) {
+            return sensor.get(max_age, sample);
+        });
+    }
+
+private:
+    // compare the channel against each index in turn, the call for the matching index is bound at compile time
+    template <size_t I, typename F>
+    typename std::enable_if<(I < sizeof...(Sensors)), int>::type visit(size_t channel, F &&f) {
+        if (channel != I) {
+            return visit<I + 1>(channel, std::forward<F>(f));
+        }
+        return f(std::get<I>(_sensors));
+    }
+
+    template <size_t I, typename F>
+    typename std::enable_if<(I == sizeof...(Sensors)), int>::type visit(size_t channel, F &&f) {
+        return SENSOR_ERROR_CHANNEL;
+    }
+
+    template <typename First>
+    static constexpr uint32_t max_interval() {
+        return First::min_interval_ms();
+    }
+
+    template <typename First, typename Second, typename... Rest>
+    static constexpr uint32_t max_interval() {
+        return First::min_interval_ms() > max_interval<Second, Rest...>() ? First::min_interval_ms()
+                                                                          : max_interval<Second, Rest...>();
+    }
+
+    std::tuple<Sensors &...> _sensors;
+};
+
+#endif
@@ -0,0 +1,29 @@
+// Fixed point climate values for the climate monitor
+//
+// A sample as the sensors take it and the range the user keeps it in, both
+// in tenths so no unit is ever rounded twice. The sensor drivers, the state
+// store and the adaptive sampling period all share them.
+//
+// This file only depends on the C library so the host tools build it too.
+
+#ifndef CLIMATE_TYPES_H
+#define CLIMATE_TYPES_H
+
+#include <stdint.h>
+
+/// one sample from a climate sensor, in fixed point
+struct SensorSample {
+    int celcius;        // tenths of a degree Celcius
+    int humidity;       // tenths of a percent RH
+    uint32_t time_ms;   // Kernel clock time the sample was read, filled in by ClimateSensor
+};
+
+/// user specified range the monitor keeps the climate in, fixed point so no unit is ever rounded twice
+struct Thresholds {
+    int temp_min;           // tenths of a degree Celcius
+    int temp_max;
+    int humidity_min;       // tenths of a percent RH
+    int humidity_max;
+};
+
+#endif
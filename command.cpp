@@ -0,0 +1,104 @@
+// Serial commands for the climate monitor
+
+#include "command.h"
+#include "telemetry.h"
+#include <atomic>
+
+#define RX_READY 1      // command_flags: the port has bytes to read
+
+static BufferedSerial *command_serial = nullptr;
+static const CommandEntry *command_table = nullptr;
+static size_t command_table_size = 0;
+static EventFlags command_flags;
+static uint8_t rx_frame[COMMAND_MAX_FRAME];
+static std::atomic<uint32_t> handled(0);
+static std::atomic<uint32_t> worst_us(0);
+
+MBED_ALIGN(8) static unsigned char command_stack[MBED_CONF_APP_COMMAND_STACK_SIZE];
+static Thread t_command(osPriorityLow, sizeof(command_stack), command_stack, "command");
+
+// Purpose: port event ISR, wake the command thread
+static void serial_event() {
+    command_flags.set(RX_READY);
+}
+
+int command_history(const uint8_t *args, CommandReply &reply) {
+    TelemetryRecord record;
+    record.type = TELEMETRY_HISTORY;
+    record.time_ms = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    record.history.offset = frame_get_u32(args);
+    record.history.chunks = args[4] < HISTORY_MAX_CHUNKS ? args[4] : HISTORY_MAX_CHUNKS;
+    return telemetry_send(record) ? COMMAND_OK : COMMAND_ERROR_BUSY;
+}
+
+// Purpose: run one command frame through the table and queue its reply
+static void handle_command(const uint8_t *payload, size_t length, uint32_t received_us) {
+    if (length < COMMAND_HEADER_SIZE) {
+        return;         // not even a tag to reply to
+    }
+    TelemetryRecord record;
+    record.type = TELEMETRY_REPLY;
+    record.time_ms = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    record.reply.command = payload[0];
+    record.reply.tag = frame_get_u16(payload + 1);
+    record.reply.status = COMMAND_ERROR_UNKNOWN;
+
+    CommandReply reply;
+    reply.count = 0;
+    size_t args = length - COMMAND_HEADER_SIZE;
+    for (size_t i = 0; i < command_table_size; i++) {
+        const CommandEntry &entry = command_table[i];
+        if (entry.command == payload[0]) {
+            record.reply.status = args == entry.args ? entry.handler(payload + COMMAND_HEADER_SIZE, reply)
+                                                     : COMMAND_ERROR_ARGS;
+            break;
+        }
+    }
+    record.reply.count = record.reply.status == COMMAND_OK ? reply.count : 0;
+    memcpy(record.reply.values, reply.values, sizeof(reply.values));
+
+    uint32_t latency = us_ticker_read() - received_us;
+    record.reply.latency_us = latency;
+    if (latency > worst_us) {
+        worst_us = latency;
+    }
+    handled++;
+    telemetry_send(record);     // a reply that finds the queue full is lost, the host asks again
+}
+
+// Purpose: command thread, sleep until the port has input, then collect it into frames and run them
+static void command_server() {
+    FrameReceiver receiver(rx_frame, sizeof(rx_frame));
+
+    while (true) {
+        command_flags.wait_any(RX_READY);
+        // only read what is there: a blocking read of an empty port would spin instead of sleeping
+        while (command_serial->readable()) {
+            uint8_t buffer[16];
+            ssize_t count = command_serial->read(buffer, sizeof(buffer));
+            uint32_t received_us = us_ticker_read();
+            for (ssize_t i = 0; i < count; i++) {
+                int length = receiver.put(buffer[i]);
+                if (length > 0) {
+                    handle_command(rx_frame, length, received_us);
+                }
+            }
+        }
+    }
+}
+
+void command_start(BufferedSerial &serial, const CommandEntry *commands, size_t count) {
+    command_serial = &serial;
+    command_table = commands;
+    command_table_size = count;
+    serial.sigio(callback(serial_event));
+    t_command.start(callback(command_server));
+}
+
+uint32_t command_count() {
+    return handled;
+}
+
+uint32_t command_worst_us() {
+    return worst_us;
+}
@@ -0,0 +1,79 @@
+// Serial commands for the climate monitor
+//
+// The host sends commands as frames (frame.h) on the same port the telemetry
+// goes out on; see telemetry_record.h for the commands and their arguments.
+// One low priority thread reads the port, collects each frame in a fixed
+// buffer and looks its command up in a table the application provides. The
+// handler fills in a reply, which is queued to the telemetry thread like any
+// other record, together with the time from the command being read off the
+// port to the reply being queued. Nothing is allocated.
+//
+// A receive interrupt keeps the core out of stop mode, so commands are only
+// read while telemetry is enabled.
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include "mbed.h"
+#include "telemetry_record.h"
+
+#define COMMAND_MAX_FRAME 64        // longest command frame, longer ones are dropped
+#define COMMAND_HEADER_SIZE 3       // command u8, tag u16
+#define HISTORY_MAX_CHUNKS 16       // chunks one COMMAND_HISTORY may ask for
+
+/// values a handler sends back, count starts at 0
+struct CommandReply {
+    uint8_t count;
+    int32_t values[COMMAND_MAX_VALUES];
+};
+
+/** Command handler.
+ *
+ * Runs on the command thread.
+ *
+ * @param args the command's arguments, as many bytes as its table entry expects
+ * @param reply values to send back
+ * @returns
+ *   COMMAND_OK, or the COMMAND_ERROR status to reply with
+ */
+typedef int (*command_handler_t)(const uint8_t *args, CommandReply &reply);
+
+/// one entry in the command table
+struct CommandEntry {
+    uint8_t command;                // COMMAND_* code
+    uint8_t args;                   // argument bytes expected, anything else is answered with COMMAND_ERROR_ARGS
+    command_handler_t handler;
+};
+
+/** Start the command thread.
+ *
+ * From here on the thread is the only code that reads from the port.
+ *
+ * @param serial port the commands arrive on
+ * @param commands table of the commands handled, unknown ones are answered with COMMAND_ERROR_UNKNOWN
+ * @param count number of entries in commands
+ */
+void command_start(BufferedSerial &serial, const CommandEntry *commands, size_t count);
+
+/** COMMAND_HISTORY handler, for the application's table.
+ *
+ * Queues the dump for the telemetry thread; the chunks go out ahead of the
+ * reply. Replies COMMAND_ERROR_BUSY if the telemetry queue is full.
+ */
+int command_history(const uint8_t *args, CommandReply &reply);
+
+/** Get the number of commands handled.
+ *
+ * @returns
+ *   commands since boot, including failed ones
+ */
+uint32_t command_count();
+
+/** Get the longest a command took.
+ *
+ * @returns
+ *   worst time in microseconds from a command being read off the port to its reply being queued
+ */
+uint32_t command_worst_us();
+
+#endif
@@ -0,0 +1,99 @@
+// DHT11 and DHT22 frames, from pulse widths to readings
+
+#include "dht_frame.h"
+
+bool dht_decode(const uint8_t widths[DHT_BITS], DHTFrame &frame) {
+    uint8_t shortest = 255;
+    uint8_t longest = 0;
+    for (int i=0; i<DHT_BITS; i++) {
+        if (widths[i] < shortest) shortest = widths[i];
+        if (widths[i] > longest) longest = widths[i];
+    }
+
+    // two-means: try every width as the cutoff and start from the split whose
+    // groups are furthest apart for their size, so one pulse stretched far out
+    // by an interrupt does not end up as a group of its own, then move the
+    // cutoff to the midpoint of the two cluster means until it settles. A frame
+    // of all 0s or all 1s has only one cluster, so it falls back to the nominal
+    // cutoff.
+    int threshold = DHT_NOMINAL_THRESHOLD;
+    if (longest - shortest >= DHT_MIN_SEPARATION) {
+        uint64_t best = 0;
+        for (int j=0; j<DHT_BITS; j++) {
+            unsigned int sum0 = 0, count0 = 0, sum1 = 0, count1 = 0;
+            for (int i=0; i<DHT_BITS; i++) {
+                if (widths[i] > widths[j]) { sum1 += widths[i]; count1++; }
+                else { sum0 += widths[i]; count0++; }
+            }
+            if (count1 == 0) continue;
+            // the between-cluster variance times DHT_BITS^2
+            int64_t spread = (int64_t)sum1 * count0 - (int64_t)sum0 * count1;
+            uint64_t score = (uint64_t)(spread * spread) / (count0 * count1);
+            if (score > best) {
+                best = score;
+                threshold = (sum0 / count0 + sum1 / count1) / 2;
+            }
+        }
+        for (int pass=0; pass<8; pass++) {
+            unsigned int sum0 = 0, count0 = 0, sum1 = 0, count1 = 0;
+            for (int i=0; i<DHT_BITS; i++) {
+                if (widths[i] > threshold) { sum1 += widths[i]; count1++; }
+                else { sum0 += widths[i]; count0++; }
+            }
+            if (count0 == 0 || count1 == 0) break;
+            int next = (sum0 / count0 + sum1 / count1) / 2;
+            if (next == threshold) break;
+            threshold = next;
+        }
+
+        // then center it in the gap between the clusters, the same bits with the most room either side
+        int below = 0, above = 255;
+        for (int i=0; i<DHT_BITS; i++) {
+            if (widths[i] <= threshold && widths[i] > below) below = widths[i];
+            if (widths[i] > threshold && widths[i] < above) above = widths[i];
+        }
+        if (above < 255) threshold = (below + above) / 2;
+    }
+
+    // read MSB to LSB, and track how close the closest pulse came to the cutoff
+    int margin = 255;
+    for (int i=0; i<5; i++) frame.bits[i] = 0;
+    for (int i=0; i<DHT_BITS; i++) {
+        int distance = widths[i] - threshold;
+        if (distance > 0) frame.bits[i / 8] |= 1 << (7 - i % 8);
+        else distance = -distance;
+        if (distance < margin) margin = distance;
+    }
+
+    frame.threshold = threshold;
+    frame.confidence = margin >= DHT_HALF_SEPARATION ? 100 : margin * 100 / DHT_HALF_SEPARATION;
+    return margin >= DHT_MIN_MARGIN;
+}
+
+// The checksum byte is the low byte of the sum of the four data bytes
+bool dht_checksum_ok(const uint8_t bits[5]) {
+    uint8_t sum = bits[0] + bits[1] + bits[2] + bits[3];
+    return bits[4] == sum;
+}
+
+bool dht11_values(const uint8_t bits[5], int &celcius, int &humidity) {
+    // validate the whole frame before anything is written, the caller keeps its last good values on error
+    if (!dht_checksum_ok(bits)) return false;
+
+    // bytes are humidity integer, humidity decimal, temperature integer, temperature decimal
+    uint8_t temperature_tenths = bits[3] & 0x7F;
+    if (bits[1] > 9 || temperature_tenths > 9) return false; // not a decimal, the frame is corrupt
+    humidity = bits[0] * 10 + bits[1];
+    int magnitude = bits[2] * 10 + temperature_tenths;
+    celcius = (bits[3] & 0x80) ? -magnitude : magnitude;
+    return true;
+}
+
+bool dht22_values(const uint8_t bits[5], int &celcius, int &humidity) {
+    if (!dht_checksum_ok(bits)) return false;
+
+    humidity = (bits[0] << 8) | bits[1];
+    int magnitude = ((bits[2] & 0x7F) << 8) | bits[3];
+    celcius = (bits[2] & 0x80) ? -magnitude : magnitude;
+    return true;
+}
@@ -0,0 +1,77 @@
+// DHT11 and DHT22 frames, from pulse widths to readings
+//
+// Bits are sent as high pulses, ~27 us for a 0 and ~70 us for a 1, 40 to a
+// frame: humidity high and low, temperature high and low, and a checksum
+// that is the low byte of the sum of the four data bytes. DHTBus (DHT.h)
+// times the pulses; everything after that is here.
+//
+// This file only depends on the C library so the host tools build it too.
+
+#ifndef DHT_FRAME_H
+#define DHT_FRAME_H
+
+#include <stdint.h>
+
+#define DHT_BITS                40  // bits in a frame
+#define DHT_NOMINAL_THRESHOLD   40  // us, fixed cutoff used when every bit has the same value
+#define DHT_MIN_SEPARATION      15  // us, clusters closer than this are treated as a single value
+#define DHT_HALF_SEPARATION     21  // us, half the nominal gap between a 0 (~27 us) and a 1 (~70 us)
+#define DHT_MIN_MARGIN          4   // us, a pulse closer than this to the cutoff could be either bit
+
+/// the bytes of a frame and how cleanly its pulses decoded
+struct DHTFrame {
+    uint8_t bits[5];        // humidity high, low, temperature high, low, checksum
+    uint8_t threshold;      // us, longer pulses were read as 1
+    uint8_t confidence;     // 0 (a pulse sat on the cutoff) to 100 (every pulse at least DHT_HALF_SEPARATION away)
+};
+
+/** Turn 40 pulse widths into the bytes of a frame.
+ *
+ * Instead of comparing each pulse against a fixed cutoff, the cutoff is
+ * placed between the two clusters of widths (two-means), so a frame whose
+ * pulses are all stretched or shortened by interrupt load or temperature
+ * still decodes. A frame whose widths are less than DHT_MIN_SEPARATION apart
+ * has only one cluster and is cut at DHT_NOMINAL_THRESHOLD.
+ *
+ * The checksum only catches some errors in two or more bits, so a frame with
+ * a pulse within DHT_MIN_MARGIN of the cutoff is refused rather than left to
+ * it: when the clusters run into each other, that is where the misread bits
+ * are.
+ *
+ * @param widths length of each high pulse in us, MSB of the first byte first
+ * @param frame receives the bytes, the cutoff and the confidence
+ * @returns
+ *   false if a pulse was within DHT_MIN_MARGIN of the cutoff, the bytes can not be trusted
+ */
+bool dht_decode(const uint8_t widths[DHT_BITS], DHTFrame &frame);
+
+/** Check the checksum byte against all four data bytes. */
+bool dht_checksum_ok(const uint8_t bits[5]);
+
+/** Read a DHT11 frame.
+ *
+ * Older DHT11s always send 0 decimals, newer revisions send tenths and flag a
+ * negative temperature in the top bit of the temperature decimal.
+ *
+ * @param bits the five bytes of the frame
+ * @param celcius receives tenths of a degree Celcius, only if the frame is valid
+ * @param humidity receives tenths of a percent RH, only if the frame is valid
+ * @returns
+ *   false if the checksum does not match or a decimal byte is not a decimal
+ */
+bool dht11_values(const uint8_t bits[5], int &celcius, int &humidity);
+
+/** Read a DHT22 frame.
+ *
+ * Both values are 16 bit tenths, the temperature is sign and magnitude with
+ * the sign in the top bit.
+ *
+ * @param bits the five bytes of the frame
+ * @param celcius receives tenths of a degree Celcius, only if the frame is valid
+ * @param humidity receives tenths of a percent RH, only if the frame is valid
+ * @returns
+ *   false if the checksum does not match
+ */
+bool dht22_values(const uint8_t bits[5], int &celcius, int &humidity);
+
+#endif
@@ -0,0 +1,128 @@
+// Runtime diagnostics for the climate monitor
+//
+// The RTOS does not keep per-thread run time, so we sample it: a ticker fires
+// MBED_CONF_APP_DIAG_SAMPLE_RATE_HZ times per second and charges the tick to
+// whichever thread it interrupted. Over a report window this gives each
+// thread's share of the core, including the idle thread (time we could sleep).
+// The bookkeeping is in runtime_window.h so the host tools can check it.
+// The ticker runs from the low power timer so it does not keep the core out
+// of stop mode, but every sample still wakes it, and a gap shorter than the
+// deep sleep latency is slept in sleep mode. At 1 kHz the core never reaches
+// stop mode and the residency reported measures the sampler itself; the
+// default of 20 Hz takes well under 1 % off it (host/sleep_residency_test.cpp)
+// but leaves each thread's share good to only a few percent per window.
+
+#include "diagnostics.h"
+#include "heap_guard.h"
+
+#if defined(__GNUC__) && !defined(__ARMCC_VERSION)
+// section boundaries from the GCC_ARM linker script
+extern uint32_t __etext;
+extern uint32_t __data_start__;
+extern uint32_t __data_end__;
+extern uint32_t __bss_start__;
+extern uint32_t __bss_end__;
+#endif
+
+static RuntimeWindow runtime;           // the window being sampled, charged by diag_sample()
+static LowPowerTicker sample_ticker;
+static mbed_stats_cpu_t last_cpu_stats;
+
+// Purpose: sampling ticker ISR, charge this tick to the interrupted thread
+static void diag_sample() {
+    runtime.charge(osThreadGetId());
+}
+
+// Purpose: print part/whole as a percentage with one decimal place
+static void print_percent(uint64_t part, uint64_t whole) {
+    uint32_t permille = runtime_permille(part, whole);
+    printf("%3lu.%lu %%", (unsigned long)(permille / 10), (unsigned long)(permille % 10));
+}
+
+void diag_start(EventQueue &queue) {
+    diag_report_footprint();
+    mbed_stats_cpu_get(&last_cpu_stats);
+    sample_ticker.attach(&diag_sample, std::chrono::microseconds(1000000 / MBED_CONF_APP_DIAG_SAMPLE_RATE_HZ));
+    queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_DIAG_REPORT_PERIOD_MS), diag_report);
+}
+
+void diag_report() {
+    // take a consistent copy of the sampler state and start a new window
+    RuntimeWindow window;
+    core_util_critical_section_enter();
+    runtime.take(window);
+    core_util_critical_section_exit();
+
+    mbed_stats_cpu_t cpu_stats;
+    mbed_stats_cpu_get(&cpu_stats);
+    uint64_t uptime = cpu_stats.uptime - last_cpu_stats.uptime;
+    uint64_t idle = cpu_stats.idle_time - last_cpu_stats.idle_time;
+    uint64_t sleep = cpu_stats.sleep_time - last_cpu_stats.sleep_time;
+    uint64_t deep_sleep = cpu_stats.deep_sleep_time - last_cpu_stats.deep_sleep_time;
+    last_cpu_stats = cpu_stats;
+
+    printf("---- diagnostics @ %lu s ----\n", (unsigned long)(cpu_stats.uptime / 1000000));
+    printf("cpu busy:   ");
+    print_percent(uptime - idle, uptime);
+    printf("  sleep: ");
+    print_percent(sleep, uptime);
+    printf("  deep sleep: ");
+    print_percent(deep_sleep, uptime);
+    printf(sleep_manager_can_deep_sleep() ? "\n" : " (locked out)\n");     // a driver or low-power false holds the lock
+
+    for (size_t i = 0; i < window.threads(); i++) {
+        const char *name = osThreadGetName((osThreadId_t)window.thread(i));
+        printf("  %-12s ", name ? name : "?");
+        print_percent(window.samples(i), window.total());
+        printf("\n");
+    }
+    if (window.unattributed()) {
+        printf("  %-12s ", "(untracked)");
+        print_percent(window.unattributed(), window.total());
+        printf("\n");
+    }
+
+    diag_report_memory();
+}
+
+void diag_report_footprint() {
+#if defined(__GNUC__) && !defined(__ARMCC_VERSION)
+    uint32_t data = (uintptr_t)&__data_end__ - (uintptr_t)&__data_start__;
+    uint32_t bss = (uintptr_t)&__bss_end__ - (uintptr_t)&__bss_start__;
+#ifdef MBED_ROM_START
+    // flash holds code and constants up to __etext, followed by the initial values of .data
+    uint32_t flash = (uintptr_t)&__etext - MBED_ROM_START + data;
+    printf("footprint: flash %lu B, ", (unsigned long)flash);
+#else
+    printf("footprint: ");
+#endif
+    printf("static RAM %lu B (data %lu B, bss %lu B)\n",
+           (unsigned long)(data + bss), (unsigned long)data, (unsigned long)bss);
+#endif
+}
+
+void diag_report_memory() {
+    // stack_space is the smallest amount of free stack ever seen (watermark),
+    // so size - space is the deepest the thread has ever gone
+    mbed_stats_thread_t threads[DIAG_MAX_STACKS];
+    size_t count = mbed_stats_thread_get_each(threads, DIAG_MAX_STACKS);
+    printf("  %-12s %6s %6s\n", "stack", "size", "peak");
+    for (size_t i = 0; i < count; i++) {
+        uint32_t peak = threads[i].stack_size - threads[i].stack_space;
+        printf("  %-12s %6lu %6lu ", threads[i].name ? threads[i].name : "?",
+               (unsigned long)threads[i].stack_size, (unsigned long)peak);
+        print_percent(peak, threads[i].stack_size);
+        printf("\n");
+    }
+
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    printf("  heap: current %lu B, peak %lu B, reserved %lu B\n",
+           (unsigned long)heap.current_size, (unsigned long)heap.max_size, (unsigned long)heap.reserved_size);
+    printf("  heap: %lu live allocations, %lu B allocated since boot, %lu failed\n",
+           (unsigned long)heap.alloc_cnt, (unsigned long)heap.total_size, (unsigned long)heap.alloc_fail_cnt);
+
+    heap_guard_check();
+    printf("  heap: %lu operator new calls, %lu B allocated after initialization\n",
+           (unsigned long)heap_guard_allocations(), (unsigned long)heap_guard_bytes());
+}
@@ -0,0 +1,47 @@
+// Runtime diagnostics for the climate monitor
+// CPU utilization, per-thread runtime and memory usage, reported over the serial console
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "mbed.h"
+#include "runtime_window.h"
+
+#define DIAG_MAX_STACKS 12      // number of thread stacks reported by diag_report_memory()
+
+/** Start runtime accounting.
+ *
+ * Attaches a sampling ticker that records which thread is running on every
+ * tick, and schedules diag_report() on the given queue every
+ * MBED_CONF_APP_DIAG_REPORT_PERIOD_MS milliseconds. The queue should be
+ * dispatched by a low priority thread so reporting does not disturb the
+ * threads being measured.
+ *
+ * @param queue event queue used to run the periodic report
+ */
+void diag_start(EventQueue &queue);
+
+/** Print CPU utilization and per-thread runtime for the last report window.
+ *
+ * Per-thread figures come from the sampling ticker, idle/sleep figures from
+ * the mbed CPU statistics (platform.cpu-stats-enabled). Both are reset at the
+ * end of every report so each report covers one window.
+ */
+void diag_report();
+
+/** Print the static RAM and flash footprint of the firmware image.
+ *
+ * Taken from the GCC_ARM linker symbols, so it is only available with that
+ * toolchain. Called once by diag_start().
+ */
+void diag_report_footprint();
+
+/** Print each thread's stack high-water mark and the heap statistics.
+ *
+ * Stack figures need platform.stack-stats-enabled (stack watermarking), heap
+ * figures need platform.heap-stats-enabled. Also runs heap_guard_check() and
+ * reports what was allocated after initialization. Called by diag_report().
+ */
+void diag_report_memory();
+
+#endif
@@ -0,0 +1,77 @@
+// Display server for the climate monitor
+
+#include "display.h"
+#include "1802.h"
+#include <atomic>
+
+// one queued screen
+struct Screen {
+    char lines[2][DISPLAY_COLS + 1];
+    uint32_t sequence;      // order the request was made in
+};
+
+static CSE321_LCD *display_lcd = nullptr;
+static MemoryPool<Screen, DISPLAY_QUEUE_DEPTH> screen_pool;
+static Queue<Screen, DISPLAY_QUEUE_DEPTH> screen_queue;
+static std::atomic<uint32_t> next_sequence(0);
+static std::atomic<uint32_t> i2c_bytes(0);
+
+MBED_ALIGN(8) static unsigned char display_stack[MBED_CONF_APP_DISPLAY_STACK_SIZE];
+static Thread t_display(osPriorityAboveNormal, sizeof(display_stack), display_stack, "display");
+
+// Purpose: display server thread, render requests as they arrive
+static void display_server() {
+    uint32_t shown = 0;         // sequence number of the screen on the LCD
+    display_lcd->begin();
+
+    while (true) {
+        Screen *screen;
+        screen_queue.try_get_for(Kernel::wait_for_u32_forever, &screen);
+
+        // anything older than what is already on the LCD is stale
+        if ((int32_t)(screen->sequence - shown) >= 0) {
+            display_lcd->clear();
+            display_lcd->print(screen->lines[0]);
+            display_lcd->setCursor(0, 1);
+            display_lcd->print(screen->lines[1]);
+            shown = screen->sequence;
+            // the LCD takes one 2 byte write per command and per character, plus its address byte
+            i2c_bytes += 3 * (2 + strlen(screen->lines[0]) + strlen(screen->lines[1]));
+        }
+        screen_pool.free(screen);
+    }
+}
+
+void display_start(CSE321_LCD &lcd) {
+    display_lcd = &lcd;
+    t_display.start(callback(display_server));
+}
+
+uint32_t display_i2c_bytes() {
+    return i2c_bytes;
+}
+
+bool display_show(const char *line0, const char *line1, uint8_t priority) {
+    Screen *screen;
+    if (priority >= DISPLAY_PRIORITY_ALERT) {
+        screen = screen_pool.try_alloc_for(std::chrono::milliseconds(DISPLAY_ALERT_WAIT_MS));
+    }
+    else {
+        screen = screen_pool.try_alloc();
+    }
+    if (screen == nullptr) {
+        return false;
+    }
+
+    strncpy(screen->lines[0], line0, DISPLAY_COLS);
+    screen->lines[0][DISPLAY_COLS] = '\0';
+    strncpy(screen->lines[1], line1, DISPLAY_COLS);
+    screen->lines[1][DISPLAY_COLS] = '\0';
+    screen->sequence = next_sequence++;
+
+    if (!screen_queue.try_put(screen, priority)) {
+        screen_pool.free(screen);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+// Display server for the climate monitor
+//
+// One thread owns the LCD. Every other task asks for a screen to be shown by
+// queueing a render request, so I2C transactions from different threads can
+// never interleave and no lock is needed on the I2C path.
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "mbed.h"
+
+class CSE321_LCD;   // 1802.h has no include guard, so it is only included by the .cpp files
+
+#define DISPLAY_COLS 16
+#define DISPLAY_QUEUE_DEPTH 8           // render requests that can be waiting at once
+#define DISPLAY_ALERT_WAIT_MS 100       // how long an alert waits for a free request slot before giving up
+
+// render request priorities - higher values are rendered first
+#define DISPLAY_PRIORITY_STATUS 0       // periodic climate readout
+#define DISPLAY_PRIORITY_PROMPT 1       // input prompts and messages for the user
+#define DISPLAY_PRIORITY_ALERT 2        // climate out of range
+
+/** Start the display server thread.
+ *
+ * The server calls lcd.begin() and from then on is the only code that may
+ * touch the LCD.
+ *
+ * @param lcd the display to take ownership of
+ */
+void display_start(CSE321_LCD &lcd);
+
+/** Ask the display server to show a screen.
+ *
+ * Requests are rendered highest priority first, oldest first within a
+ * priority. A request that was made before the screen currently on the LCD
+ * is dropped rather than rendered, so an alert is never overwritten by a
+ * status update that was already waiting when the alert arrived. Only alert
+ * requests wait for a free slot; others are dropped if the queue is full.
+ * Must not be called from an ISR.
+ *
+ * @param line0 text for the top row, truncated to DISPLAY_COLS characters
+ * @param line1 text for the bottom row, truncated to DISPLAY_COLS characters
+ * @param priority DISPLAY_PRIORITY_STATUS, DISPLAY_PRIORITY_PROMPT or DISPLAY_PRIORITY_ALERT
+ * @returns
+ *   true if the request was queued, false if it was dropped
+ */
+bool display_show(const char *line0, const char *line1, uint8_t priority);
+
+/** Get the I2C traffic the display server has generated.
+ *
+ * @returns
+ *   bytes written to the LCD since boot, address bytes included
+ */
+uint32_t display_i2c_bytes();
+
+#endif
@@ -0,0 +1,60 @@
+// Energy budget estimate for the climate monitor
+
+#include "energy.h"
+
+// Purpose: Kernel clock time in milliseconds, wraps after 49 days which the unsigned differences below tolerate
+static uint32_t now_ms() {
+    return (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+}
+
+ActivityTimer::ActivityTimer() : _total_ms(0), _since_ms(0), _on(false) {
+}
+
+void ActivityTimer::set(bool on) {
+    core_util_critical_section_enter();
+    if (on && !_on) {
+        _since_ms = now_ms();
+    }
+    else if (!on && _on) {
+        _total_ms += now_ms() - _since_ms;
+    }
+    _on = on;
+    core_util_critical_section_exit();
+}
+
+uint32_t ActivityTimer::on_ms() const {
+    core_util_critical_section_enter();
+    uint32_t total = _total_ms;
+    if (_on) {
+        total += now_ms() - _since_ms;
+    }
+    core_util_critical_section_exit();
+    return total;
+}
+
+EnergyModel energy_model() {
+    return {
+        MBED_CONF_APP_ENERGY_RUN_UA,
+        MBED_CONF_APP_ENERGY_SLEEP_UA,
+        MBED_CONF_APP_ENERGY_STOP_UA,
+        MBED_CONF_APP_ENERGY_BACKLIGHT_UA,
+        MBED_CONF_APP_ENERGY_BUZZER_UA,
+        MBED_CONF_APP_ENERGY_LED_UA,
+        MBED_CONF_APP_ENERGY_SENSOR_IDLE_UA,
+        MBED_CONF_APP_ENERGY_SENSOR_READ_UC,
+        MBED_CONF_APP_ENERGY_I2C_BYTE_NC,
+    };
+}
+
+void energy_report(const ActivityCounters &counters, const EnergyModel &model) {
+    uint32_t average = energy_average_ua(counters, model);
+    uint32_t per_day = energy_per_day(average);     // tenths of a mAh
+    printf("energy: run %lu ms, sleep %lu ms, stop %lu ms of %lu ms\n", (unsigned long)counters.run_ms,
+           (unsigned long)counters.sleep_ms, (unsigned long)counters.stop_ms, (unsigned long)counters.window_ms);
+    printf("  backlight %lu ms, buzzer %lu ms, led %lu ms, i2c %lu B, %lu reads of %lu sensors\n",
+           (unsigned long)counters.backlight_ms, (unsigned long)counters.buzzer_ms, (unsigned long)counters.led_ms,
+           (unsigned long)counters.i2c_bytes, (unsigned long)counters.sensor_reads,
+           (unsigned long)counters.sensors);
+    printf("  average %lu uA, %lu.%lu mAh/day\n", (unsigned long)average, (unsigned long)(per_day / 10),
+           (unsigned long)(per_day % 10));
+}
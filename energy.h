@@ -0,0 +1,55 @@
+// Energy budget estimate for the climate monitor
+//
+// The on-time counters the linear model in energy_model.h needs, the model
+// as configured in mbed_app.json, and the text report. The counters are
+// printed in full with each report so host/energy_eval can evaluate a
+// console capture against other models.
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include "mbed.h"
+#include "energy_model.h"
+
+/** Accumulates how long an output has been switched on.
+ *
+ * set() may be called from threads and ISRs alike.
+ */
+class ActivityTimer {
+public:
+    ActivityTimer();
+
+    /** Record the output switching on or off, repeating the current state is harmless.
+     *
+     * @param on new state of the output
+     */
+    void set(bool on);
+
+    /** Get the total time the output has been on, including the current stretch.
+     *
+     * @returns
+     *   milliseconds on since boot
+     */
+    uint32_t on_ms() const;
+
+private:
+    uint32_t _total_ms;     // completed stretches
+    uint32_t _since_ms;     // Kernel clock time the current stretch started
+    bool _on;
+};
+
+/** Get the model configured in mbed_app.json.
+ *
+ * @returns
+ *   the energy-* config values
+ */
+EnergyModel energy_model();
+
+/** Print the counters, the average current and the charge drawn per day.
+ *
+ * @param counters activity over the window
+ * @param model current of each component
+ */
+void energy_report(const ActivityCounters &counters, const EnergyModel &model);
+
+#endif
@@ -0,0 +1,40 @@
+// Linear energy model for the climate monitor
+
+#include "energy_model.h"
+
+uint32_t energy_average_ua(const ActivityCounters &counters, const EnergyModel &model) {
+    if (counters.window_ms == 0) {
+        return 0;
+    }
+    // charge in nanocoulombs: uA x ms, uC x 1000, nC
+    uint64_t charge = (uint64_t)model.run_ua * counters.run_ms;
+    charge += (uint64_t)model.sleep_ua * counters.sleep_ms;
+    charge += (uint64_t)model.stop_ua * counters.stop_ms;
+    charge += (uint64_t)model.backlight_ua * counters.backlight_ms;
+    charge += (uint64_t)model.buzzer_ua * counters.buzzer_ms;
+    charge += (uint64_t)model.led_ua * counters.led_ms;
+    charge += (uint64_t)model.sensor_idle_ua * counters.sensors * counters.window_ms;
+    charge += (uint64_t)model.sensor_read_uc * 1000 * counters.sensor_reads;
+    charge += (uint64_t)model.i2c_byte_nc * counters.i2c_bytes;
+    return (uint32_t)(charge / counters.window_ms);     // nC / ms = uA
+}
+
+uint32_t energy_per_day(uint32_t average_ua) {
+    return (uint32_t)((uint64_t)average_ua * 24 / 100);    // uA x 24 h / 1000, in tenths
+}
+
+ActivityCounters energy_interval(const ActivityCounters &later, const ActivityCounters &earlier) {
+    // unsigned differences, so a counter that wrapped between the two still comes out right
+    ActivityCounters interval;
+    interval.window_ms = later.window_ms - earlier.window_ms;
+    interval.run_ms = later.run_ms - earlier.run_ms;
+    interval.sleep_ms = later.sleep_ms - earlier.sleep_ms;
+    interval.stop_ms = later.stop_ms - earlier.stop_ms;
+    interval.backlight_ms = later.backlight_ms - earlier.backlight_ms;
+    interval.buzzer_ms = later.buzzer_ms - earlier.buzzer_ms;
+    interval.led_ms = later.led_ms - earlier.led_ms;
+    interval.i2c_bytes = later.i2c_bytes - earlier.i2c_bytes;
+    interval.sensor_reads = later.sensor_reads - earlier.sensor_reads;
+    interval.sensors = later.sensors;
+    return interval;
+}
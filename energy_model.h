@@ -0,0 +1,73 @@
+// Linear energy model for the climate monitor
+//
+// Every component that draws a significant current reports how long (or how
+// often) it was active, and a linear model turns those counters into an
+// average current: each component's current times its share of the time,
+// plus a fixed charge per sensor read and per byte on the I2C bus. The
+// currents come from mbed_app.json so a board can be characterised once and
+// different configurations compared from their counters alone.
+//
+// This file only depends on the C library so the host tools build it too.
+
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdint.h>
+
+/// what each component did over a window, usually since boot
+struct ActivityCounters {
+    uint32_t window_ms;         // length of the window
+    uint32_t run_ms;            // core running
+    uint32_t sleep_ms;          // core in sleep mode
+    uint32_t stop_ms;           // core in stop mode
+    uint32_t backlight_ms;      // LCD backlight on
+    uint32_t buzzer_ms;         // buzzer on
+    uint32_t led_ms;            // LED on
+    uint32_t i2c_bytes;         // bytes moved on the I2C bus, address bytes included
+    uint32_t sensor_reads;      // sensor reads that reached the bus
+    uint32_t sensors;           // sensors drawing their idle current
+};
+
+/// current drawn by each component, in the units of the mbed_app.json energy-* entries
+struct EnergyModel {
+    uint32_t run_ua;            // core running
+    uint32_t sleep_ua;          // core in sleep mode
+    uint32_t stop_ua;           // core in stop mode
+    uint32_t backlight_ua;
+    uint32_t buzzer_ua;
+    uint32_t led_ua;
+    uint32_t sensor_idle_ua;    // per sensor, between reads
+    uint32_t sensor_read_uc;    // charge of one sensor read, start signal to last bit
+    uint32_t i2c_byte_nc;       // charge of one byte on the I2C bus
+};
+
+/** Estimate the average current drawn over the counters' window.
+ *
+ * A pure function of its arguments, so a trace of counters can be evaluated
+ * off target against other models.
+ *
+ * @param counters activity over the window
+ * @param model current of each component
+ * @returns
+ *   average current in microamps, 0 for an empty window
+ */
+uint32_t energy_average_ua(const ActivityCounters &counters, const EnergyModel &model);
+
+/** Convert an average current to the charge drawn in a day.
+ *
+ * @param average_ua average current in microamps
+ * @returns
+ *   tenths of a mAh per day
+ */
+uint32_t energy_per_day(uint32_t average_ua);
+
+/** Get the activity between two sets of counters taken from the same boot.
+ *
+ * @param later counters taken second
+ * @param earlier counters taken first
+ * @returns
+ *   the difference of every counter, the sensor count of later
+ */
+ActivityCounters energy_interval(const ActivityCounters &later, const ActivityCounters &earlier);
+
+#endif
@@ -0,0 +1,120 @@
+// Byte stuffed, CRC checked frames for the serial port
+
+#include "frame.h"
+
+uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+FrameEncoder::FrameEncoder(uint8_t *buffer, size_t size)
+    : _buffer(buffer), _size(size), _length(1), _code(0), _crc(FRAME_CRC_INIT), _overflow(size < 1) {
+}
+
+void FrameEncoder::stuff(uint8_t byte) {
+    if (_overflow) {
+        return;
+    }
+    // COBS: each block starts with a code byte holding the distance to the next zero, which is then left out
+    if (byte != 0) {
+        if (_length >= _size) {
+            _overflow = true;
+            return;
+        }
+        _buffer[_length++] = byte;
+    }
+    if (byte == 0 || _length - _code == 255) {
+        _buffer[_code] = _length - _code;
+        if (_length >= _size) {
+            _overflow = true;
+            return;
+        }
+        _code = _length++;
+    }
+}
+
+void FrameEncoder::put(uint8_t byte) {
+    _crc = crc16(&byte, 1, _crc);
+    stuff(byte);
+}
+
+void FrameEncoder::put_u16(uint16_t value) {
+    put(value & 0xFF);
+    put(value >> 8);
+}
+
+void FrameEncoder::put_u32(uint32_t value) {
+    put_u16(value & 0xFFFF);
+    put_u16(value >> 16);
+}
+
+void FrameEncoder::put_bytes(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        put(data[i]);
+    }
+}
+
+size_t FrameEncoder::finish() {
+    uint16_t crc = _crc;
+    stuff(crc & 0xFF);
+    stuff(crc >> 8);
+    if (_overflow || _length >= _size) {
+        return 0;
+    }
+    _buffer[_code] = _length - _code;
+    _buffer[_length++] = 0;
+    return _length;
+}
+
+int frame_decode(uint8_t *frame, size_t length) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < length) {
+        uint8_t code = frame[in++];
+        if (code == 0 || in + code - 1 > length) {
+            return -1;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            frame[out++] = frame[in++];
+        }
+        // a block shorter than 254 bytes stood for a zero, unless it ends the frame
+        if (code != 255 && in < length) {
+            frame[out++] = 0;
+        }
+    }
+    if (out < FRAME_CRC_SIZE) {
+        return -1;
+    }
+    size_t payload = out - FRAME_CRC_SIZE;
+    uint16_t crc = frame[payload] | (frame[payload + 1] << 8);
+    return crc16(frame, payload) == crc ? (int)payload : -1;
+}
+
+FrameReceiver::FrameReceiver(uint8_t *buffer, size_t size) : _buffer(buffer), _size(size), _length(0), _overflow(false) {
+}
+
+int FrameReceiver::put(uint8_t byte) {
+    if (byte != 0) {
+        if (_length < _size) {
+            _buffer[_length++] = byte;
+        }
+        else {
+            _overflow = true;
+        }
+        return FRAME_PENDING;
+    }
+
+    size_t length = _length;
+    bool overflow = _overflow;
+    _length = 0;
+    _overflow = false;
+    if (length == 0) {
+        return FRAME_PENDING;   // back to back delimiters, or the first one after starting mid-stream
+    }
+    return overflow ? -1 : frame_decode(_buffer, length);
+}
@@ -0,0 +1,150 @@
+// Byte stuffed, CRC checked frames for the serial port
+//
+// A frame is its payload followed by a CRC-16/CCITT-FALSE of the payload
+// (little endian), COBS encoded so it contains no zero bytes, and terminated
+// by a single zero byte. A receiver that starts mid-stream or loses bytes
+// resynchronises at the next zero, and the CRC rejects whatever was damaged.
+//
+// This file only depends on the C library so the host tools build it too.
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_CRC_INIT 0xFFFF
+#define FRAME_CRC_SIZE 2
+#define FRAME_PENDING -2        // FrameReceiver::put(): no complete frame yet
+
+// largest encoded frame for a payload of n bytes: CRC, one COBS code per 254 bytes plus one, and the delimiter
+#define FRAME_ENCODED_SIZE(n) ((n) + FRAME_CRC_SIZE + ((n) + FRAME_CRC_SIZE) / 254 + 2)
+
+/** Compute or continue a CRC-16/CCITT-FALSE (polynomial 0x1021, no reflection).
+ *
+ * @param data bytes to add
+ * @param length number of bytes
+ * @param crc FRAME_CRC_INIT to start, or the result of the previous call to continue
+ * @returns
+ *   the CRC including data
+ */
+uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc = FRAME_CRC_INIT);
+
+/** Builds one frame straight into a transmit buffer.
+ *
+ * Payload bytes are stuffed and added to the CRC as they are put, so the
+ * payload never exists unencoded anywhere.
+ *
+ * Example:
+ * @code
+ * uint8_t tx[FRAME_ENCODED_SIZE(6)];
+ * FrameEncoder frame(tx, sizeof(tx));
+ * frame.put(1);
+ * frame.put_u32(Kernel::Clock::now().time_since_epoch().count());
+ * frame.put_u16(42);
+ * size_t length = frame.finish();     // 0 if tx was too small
+ * serial.write(tx, length);
+ * @endcode
+ */
+class FrameEncoder {
+public:
+    /** Start a frame.
+     *
+     * @param buffer receives the encoded frame
+     * @param size size of buffer, FRAME_ENCODED_SIZE of the payload is always enough
+     */
+    FrameEncoder(uint8_t *buffer, size_t size);
+
+    /** Append one payload byte. */
+    void put(uint8_t byte);
+
+    /** Append a 16 bit value, little endian. */
+    void put_u16(uint16_t value);
+
+    /** Append a 32 bit value, little endian. */
+    void put_u32(uint32_t value);
+
+    /** Append payload bytes. */
+    void put_bytes(const uint8_t *data, size_t length);
+
+    /** Append the CRC and the delimiter.
+     *
+     * @returns
+     *   length of the encoded frame in the buffer, 0 if it did not fit
+     */
+    size_t finish();
+
+private:
+    // stuff one byte without adding it to the CRC
+    void stuff(uint8_t byte);
+
+    uint8_t *_buffer;
+    size_t _size;
+    size_t _length;     // bytes used, including the pending code byte
+    size_t _code;       // index of the code byte of the current block
+    uint16_t _crc;
+    bool _overflow;
+};
+
+/** Read a 16 bit little endian value, as put by FrameEncoder::put_u16(). */
+inline uint16_t frame_get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+/** Read a 32 bit little endian value, as put by FrameEncoder::put_u32(). */
+inline uint32_t frame_get_u32(const uint8_t *p) {
+    return frame_get_u16(p) | ((uint32_t)frame_get_u16(p + 2) << 16);
+}
+
+/** Decode one frame in place.
+ *
+ * @param frame the bytes received between two delimiters, overwritten with the payload
+ * @param length number of bytes
+ * @returns
+ *   payload length, or -1 if the frame is malformed or its CRC does not match
+ */
+int frame_decode(uint8_t *frame, size_t length);
+
+/** Collects received bytes into frames.
+ *
+ * Bytes are kept until a delimiter arrives, then the frame is decoded in
+ * place. A frame longer than the buffer is dropped whole.
+ *
+ * Example:
+ * @code
+ * uint8_t rx[64];
+ * FrameReceiver receiver(rx, sizeof(rx));
+ * while (serial.read(&byte, 1) == 1) {
+ *     int length = receiver.put(byte);
+ *     if (length > 0) {
+ *         handle(rx, length);
+ *     }
+ * }
+ * @endcode
+ */
+class FrameReceiver {
+public:
+    /** Construct the receiver.
+     *
+     * @param buffer holds the frame being received, and the payload once it is complete
+     * @param size size of buffer, FRAME_ENCODED_SIZE of the longest payload expected
+     */
+    FrameReceiver(uint8_t *buffer, size_t size);
+
+    /** Add one received byte.
+     *
+     * @param byte the byte
+     * @returns
+     *   payload length if the byte completed a valid frame, the payload is in the buffer until the next call;
+     *   -1 if it completed a malformed, damaged or too long frame; FRAME_PENDING otherwise
+     */
+    int put(uint8_t byte);
+
+private:
+    uint8_t *_buffer;
+    size_t _size;
+    size_t _length;
+    bool _overflow;
+};
+
+#endif
@@ -0,0 +1,121 @@
+// Heap guard for the climate monitor
+//
+// All long lived objects (thread stacks, event queue storage, input and
+// format buffers) are statically allocated, so once main() has finished
+// initializing nothing should touch the heap again. This module makes that a
+// checked property instead of an assumption.
+
+#include "heap_guard.h"
+#include <atomic>
+#include <cstddef>
+#include <malloc.h>
+#include <new>
+
+// operator new runs on whichever thread allocates, so what it touches is atomic
+static std::atomic<bool> armed(false);
+static std::atomic<uint32_t> new_count(0);  // operator new calls since arming
+static uint32_t armed_total_size = 0;       // bytes allocated since boot when armed, written before armed is set
+static std::atomic<uint32_t> growth(0);     // bytes allocated since arming, as of the last heap_guard_check()
+
+void heap_guard_arm() {
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    armed_total_size = heap.total_size;
+    armed = true;
+}
+
+void heap_guard_check() {
+    if (!armed) {
+        return;
+    }
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    // total_size is the sum of every allocation ever made and never goes down, so unlike the live allocation
+    // count it also moves when a block is freed and another one allocated in its place
+    if (heap.total_size != armed_total_size) {
+        growth = heap.total_size - armed_total_size;
+#if MBED_CONF_APP_STATIC_ALLOC
+        MBED_ERROR(MBED_MAKE_ERROR(MBED_MODULE_APPLICATION, MBED_ERROR_CODE_OUT_OF_MEMORY),
+                   "heap allocation after initialization");
+#endif
+    }
+}
+
+uint32_t heap_guard_allocations() {
+    return new_count;
+}
+
+uint32_t heap_guard_bytes() {
+    return growth;
+}
+
+// Purpose: count every C++ allocation once armed, trap it in static-alloc mode. Running out of memory is fatal
+// unless the caller asked for a nullptr instead (the nothrow forms)
+static void *guarded_alloc(size_t size, size_t alignment, bool nothrow) {
+    if (armed) {
+        new_count++;
+#if MBED_CONF_APP_STATIC_ALLOC
+        MBED_ERROR(MBED_MAKE_ERROR(MBED_MODULE_APPLICATION, MBED_ERROR_CODE_OUT_OF_MEMORY),
+                   "operator new after initialization");
+#endif
+    }
+    void *ptr = alignment > alignof(std::max_align_t) ? memalign(alignment, size) : malloc(size);
+    if (ptr == nullptr && !nothrow) {
+        MBED_ERROR(MBED_ERROR_OUT_OF_MEMORY, "operator new out of memory");
+    }
+    return ptr;
+}
+
+// every form of operator new goes through guarded_alloc(), or one that is left out allocates unseen
+
+void *operator new(size_t size) {
+    return guarded_alloc(size, 0, false);
+}
+
+void *operator new[](size_t size) {
+    return guarded_alloc(size, 0, false);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return guarded_alloc(size, 0, true);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return guarded_alloc(size, 0, true);
+}
+
+#if __cpp_aligned_new
+// over-aligned types (alignas above max_align_t), C++17 and later; the matching deletes free what memalign() gave
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    return guarded_alloc(size, (size_t)alignment, false);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return guarded_alloc(size, (size_t)alignment, false);
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return guarded_alloc(size, (size_t)alignment, true);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return guarded_alloc(size, (size_t)alignment, true);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+    free(ptr);
+}
+#endif
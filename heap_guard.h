@@ -0,0 +1,42 @@
+// Heap guard for the climate monitor
+// Counts (or traps) heap allocations made after initialization
+
+#ifndef HEAP_GUARD_H
+#define HEAP_GUARD_H
+
+#include "mbed.h"
+
+#define HEAP_GUARD_CHECK_PERIOD 1000ms  // how often heap_guard_check() should run, whatever else is enabled
+
+/** Mark the end of initialization.
+ *
+ * From here on every C++ allocation (every form of operator new, nothrow
+ * and over-aligned included) is counted, and in static-alloc mode
+ * (MBED_CONF_APP_STATIC_ALLOC) raises a fatal error on the spot. C allocations (malloc) cannot be intercepted without the linker, so
+ * they are caught by heap_guard_check() through the mbed heap statistics.
+ */
+void heap_guard_arm();
+
+/** Compare the heap statistics against the ones taken when armed.
+ *
+ * In static-alloc mode any growth is a fatal error, otherwise it is only
+ * reported through heap_guard_bytes(). Takes the heap statistics lock, so
+ * it must run on a thread; schedule it every HEAP_GUARD_CHECK_PERIOD.
+ */
+void heap_guard_check();
+
+/** Get the number of C++ allocations (operator new) made since heap_guard_arm().
+ *
+ * @returns
+ *   operator new calls, counted as they happen
+ */
+uint32_t heap_guard_allocations();
+
+/** Get the number of bytes allocated since heap_guard_arm(), C and C++ alike.
+ *
+ * @returns
+ *   growth of the heap statistics' allocation total, as of the last heap_guard_check()
+ */
+uint32_t heap_guard_bytes();
+
+#endif
@@ -0,0 +1,31 @@
+// Sample history for the climate monitor
+
+#include "history.h"
+
+static HistoryEntry entries[HISTORY_SIZE];
+static uint32_t end_index = 0;      // index the next entry is stored at
+static Mutex history_mutex;         // t_monitor appends while the telemetry thread reads
+
+void history_append(const HistoryEntry &entry) {
+    history_mutex.lock();
+    entries[end_index % HISTORY_SIZE] = entry;
+    end_index++;
+    history_mutex.unlock();
+}
+
+void history_read(uint32_t offset, HistoryChunk &chunk) {
+    history_mutex.lock();
+    uint32_t first = end_index > HISTORY_SIZE ? end_index - HISTORY_SIZE : 0;
+    if (offset < first) {
+        offset = first;
+    }
+    uint32_t available = offset < end_index ? end_index - offset : 0;
+    chunk.offset = offset;
+    chunk.first = first;
+    chunk.end = end_index;
+    chunk.count = available < HISTORY_CHUNK_ENTRIES ? available : HISTORY_CHUNK_ENTRIES;
+    for (uint8_t i = 0; i < chunk.count; i++) {
+        chunk.entries[i] = entries[(offset + i) % HISTORY_SIZE];
+    }
+    history_mutex.unlock();
+}
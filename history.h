@@ -0,0 +1,36 @@
+// Sample history for the climate monitor
+//
+// Every sample is stored in a ring buffer in RAM, history-size entries deep,
+// so the host can pull what it missed with a history dump (COMMAND_HISTORY,
+// telemetry_record.h). Entries are numbered from the first one stored since
+// boot; once the ring is full the oldest are overwritten, and a dump from an
+// overwritten index starts at the oldest one still stored.
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "mbed.h"
+#include "telemetry_record.h"
+
+#define HISTORY_SIZE MBED_CONF_APP_HISTORY_SIZE     // entries kept
+
+/** Store a sample, overwriting the oldest once the ring is full.
+ *
+ * Not ISR safe.
+ *
+ * @param entry the sample
+ */
+void history_append(const HistoryEntry &entry);
+
+/** Copy stored samples into a chunk.
+ *
+ * Fills in the chunk's offset, first, end and count: the copy starts at
+ * offset, or at the oldest stored entry if offset was overwritten, and
+ * holds up to HISTORY_CHUNK_ENTRIES entries. Not ISR safe.
+ *
+ * @param offset index of the first entry wanted
+ * @param chunk receives the entries
+ */
+void history_read(uint32_t offset, HistoryChunk &chunk);
+
+#endif
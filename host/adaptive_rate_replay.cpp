@@ -0,0 +1,288 @@
+// Replay climate traces through the adaptive sampling period
+//
+// Runs adaptive_interval_ms() the way t_monitor does: read the trace at the
+// current time, pick the next read from the previous and current samples,
+// and jump ahead by that much. The same trace is also read at the fixed
+// sensor interval. For each trace it prints the reads taken both ways (the
+// samples saved) and, for every time the climate leaves the range, how long
+// each schedule took to see it (the detection delay).
+//
+// Fails if a period was chosen that would, at the rate of change it was
+// chosen from, reach a limit in fewer than ADAPTIVE_LEAD reads, or if on a
+// trace without jumps the climate left the range with fewer than
+// ADAPTIVE_LEAD reads taken since the last read that still had that much
+// time left at the shortest period. The built in traces are synthetic;
+// give a CSV from history_dump to replay a recorded one, its samples joined
+// by straight lines. Build and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. adaptive_rate_replay.cpp ../adaptive_rate.cpp -o adaptive_rate_replay
+//   ./adaptive_rate_replay [history.csv [sensor]]
+
+#include "adaptive_rate.h"
+#include "check.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define MIN_MS 2000             // sensor-interval-ms
+#define MAX_MS 10000            // sensor-max-interval-ms
+#define STEP_MS 100             // resolution the crossings are found at
+
+static const Thresholds range = {180, 260, 300, 600};
+
+// one point of a trace, in the tenths of a sample
+struct Point {
+    uint32_t time_ms;
+    double celcius;
+    double humidity;
+};
+
+// a trace and whether it may jump faster than the rate of change can predict
+struct Trace {
+    const char *name;
+    bool jumps;
+    std::vector<Point> points;
+};
+
+// Purpose: the climate at time_ms, on the straight line between the points around it, rounded like a sensor does
+static SensorSample sample_at(const Trace &trace, uint32_t time_ms) {
+    const std::vector<Point> &points = trace.points;
+    size_t i = 1;
+    while (i < points.size() - 1 && points[i].time_ms < time_ms) {
+        i++;
+    }
+    const Point &a = points[i - 1];
+    const Point &b = points[i];
+    double f = b.time_ms == a.time_ms ? 1 : ((double)time_ms - a.time_ms) / ((double)b.time_ms - a.time_ms);
+    f = f < 0 ? 0 : f > 1 ? 1 : f;
+    SensorSample sample;
+    sample.celcius = (int)lround(a.celcius + f * (b.celcius - a.celcius));
+    sample.humidity = (int)lround(a.humidity + f * (b.humidity - a.humidity));
+    sample.time_ms = time_ms;
+    return sample;
+}
+
+// Purpose: true if a sample is outside the range
+static bool outside(const SensorSample &sample) {
+    return sample.celcius < range.temp_min || sample.celcius > range.temp_max ||
+           sample.humidity < range.humidity_min || sample.humidity > range.humidity_max;
+}
+
+// Purpose: false if interval reaches a limit in fewer than ADAPTIVE_LEAD reads at the rate from previous to current
+static bool lead_kept(const SensorSample &previous, const SensorSample &current, uint32_t interval) {
+    if (interval <= MIN_MS || previous.time_ms == 0) {
+        return true;        // as often as the sensor allows, nothing faster to pick
+    }
+    uint32_t elapsed = current.time_ms - previous.time_ms;
+    const int values[2][4] = {{current.celcius, previous.celcius, range.temp_min, range.temp_max},
+                              {current.humidity, previous.humidity, range.humidity_min, range.humidity_max}};
+    for (const int *v : values) {
+        int change = v[0] - v[1];
+        int distance = change > 0 ? v[3] - v[0] : v[0] - v[2];
+        if (change != 0 && (uint64_t)distance * elapsed / std::abs(change) < (uint64_t)interval * ADAPTIVE_LEAD) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Purpose: the times a schedule reads the trace, the adaptive one when fixed is false
+static std::vector<uint32_t> schedule(const Trace &trace, bool fixed, unsigned &short_leads) {
+    std::vector<uint32_t> reads;
+    SensorSample previous = {0, 0, 0};
+    uint32_t end = trace.points.back().time_ms;
+    for (uint32_t now = trace.points.front().time_ms; now <= end;) {
+        SensorSample current = sample_at(trace, now);
+        reads.push_back(now);
+        uint32_t interval = MIN_MS;
+        if (!fixed) {
+            interval = adaptive_interval_ms(previous, current, range, MIN_MS, MAX_MS);
+            if (!lead_kept(previous, current, interval)) {
+                short_leads++;
+            }
+        }
+        previous = current;
+        now += interval;
+    }
+    return reads;
+}
+
+// Purpose: first read at or after time_ms, UINT32_MAX if there is none
+static uint32_t first_read(const std::vector<uint32_t> &reads, uint32_t time_ms) {
+    for (uint32_t read : reads) {
+        if (read >= time_ms) {
+            return read;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Purpose: reads in (from, to]
+static unsigned reads_between(const std::vector<uint32_t> &reads, uint32_t from, uint32_t to) {
+    unsigned count = 0;
+    for (uint32_t read : reads) {
+        count += read > from && read <= to;
+    }
+    return count;
+}
+
+// Purpose: replay one trace both ways, print what the adaptive period saved and cost, and check its lead
+static void replay(const Trace &trace) {
+    unsigned short_leads = 0;
+    unsigned unused = 0;
+    std::vector<uint32_t> adaptive = schedule(trace, false, short_leads);
+    std::vector<uint32_t> fixed = schedule(trace, true, unused);
+
+    // every time the climate leaves the range, and how long each schedule takes to read it outside
+    unsigned crossings = 0;
+    unsigned late = 0;
+    uint32_t worst_adaptive = 0;
+    uint32_t worst_fixed = 0;
+    uint64_t total_adaptive = 0;
+    uint64_t total_fixed = 0;
+    bool was_outside = outside(sample_at(trace, trace.points.front().time_ms));
+    for (uint32_t t = trace.points.front().time_ms; t <= trace.points.back().time_ms; t += STEP_MS) {
+        bool is_outside = outside(sample_at(trace, t));
+        if (is_outside && !was_outside) {
+            crossings++;
+            uint32_t seen_adaptive = first_read(adaptive, t);
+            uint32_t seen_fixed = first_read(fixed, t);
+            if (seen_adaptive != UINT32_MAX && seen_fixed != UINT32_MAX) {
+                // a read whose sample shows it, the trace may wander back before the next one
+                uint32_t delay = seen_adaptive - t;
+                total_adaptive += delay;
+                total_fixed += seen_fixed - t;
+                worst_adaptive = delay > worst_adaptive ? delay : worst_adaptive;
+                worst_fixed = seen_fixed - t > worst_fixed ? seen_fixed - t : worst_fixed;
+            }
+            // the last read that left room for ADAPTIVE_LEAD reads at the shortest period must be followed by them
+            uint32_t lead_start = t > MIN_MS * ADAPTIVE_LEAD ? t - MIN_MS * ADAPTIVE_LEAD : 0;
+            uint32_t from = 0;
+            for (uint32_t read : adaptive) {
+                if (read <= lead_start) {
+                    from = read;
+                }
+            }
+            if (reads_between(adaptive, from, t) < ADAPTIVE_LEAD) {
+                late++;
+            }
+        }
+        was_outside = is_outside;
+    }
+
+    double saved = 100.0 * (1.0 - (double)adaptive.size() / fixed.size());
+    printf("%-22s %6zu %6zu %5.1f %%  %3u", trace.name, fixed.size(), adaptive.size(), saved, crossings);
+    if (crossings) {
+        printf("   %5.1f / %5.1f s   %5.1f / %5.1f s   %u", total_fixed / 1000.0 / crossings,
+               total_adaptive / 1000.0 / crossings, worst_fixed / 1000.0, worst_adaptive / 1000.0, late);
+    }
+    printf("\n");
+
+    if (short_leads) {
+        printf("FAIL %s: %u periods would reach a limit in fewer than %d reads at their rate of change\n", trace.name,
+               short_leads, ADAPTIVE_LEAD);
+        failed();
+    }
+    if (late && !trace.jumps) {
+        printf("FAIL %s: %u crossings reached in fewer than %d reads\n", trace.name, late, ADAPTIVE_LEAD);
+        failed();
+    }
+}
+
+// Purpose: a trace from a function of the time in seconds, one point a second
+template <typename F>
+static Trace synthetic(const char *name, bool jumps, uint32_t seconds, F climate) {
+    Trace trace = {name, jumps, {}};
+    for (uint32_t s = 0; s <= seconds; s++) {
+        Point point;
+        point.time_ms = 1000 + s * 1000;       // time 0 means no sample yet
+        climate(s, point.celcius, point.humidity);
+        trace.points.push_back(point);
+    }
+    return trace;
+}
+
+// Purpose: the built in traces, an hour each
+static std::vector<Trace> synthetic_traces() {
+    std::vector<Trace> traces;
+    traces.push_back(synthetic("steady room", false, 3600, [](double s, double &c, double &h) {
+        c = 220 + 1.5 * sin(s / 600);
+        h = 450 + 3 * sin(s / 900);
+    }));
+    traces.push_back(synthetic("slow drift up", false, 3600, [](double s, double &c, double &h) {
+        c = 220 + 60 * s / 3600;                // 22.0 to 28.0 C
+        h = 450;
+    }));
+    traces.push_back(synthetic("heating cycle", false, 3600, [](double s, double &c, double &h) {
+        c = 220 + 45 * sin(2 * M_PI * s / 1200);    // 17.5 to 26.5 C every 20 minutes
+        h = 450 - 50 * sin(2 * M_PI * s / 1200);
+    }));
+    traces.push_back(synthetic("shower next door", false, 3600, [](double s, double &c, double &h) {
+        c = 220;
+        h = s < 1200 ? 450 : 450 + 250 * (1 - exp(-(s - 1200) / 300));   // settles at 70 %RH
+    }));
+    traces.push_back(synthetic("heater at the probe", false, 3600, [](double s, double &c, double &h) {
+        c = s < 600 ? 200 : fmin(200 + 0.8 * (s - 600), 300);     // 20.0 C, then up 0.8 C every 10 s to 30.0 C
+        c = s < 1800 ? c : fmax(300 - 0.8 * (s - 1800), 200);    // and back down after the heater is switched off
+        h = 450;
+    }));
+    traces.push_back(synthetic("humidifier", false, 3600, [](double s, double &c, double &h) {
+        c = 220;
+        h = s < 600 ? 400 : fmin(400 + 1.5 * (s - 600), 750);     // 40 %RH, then up 1.5 %RH every 10 s to 75 %RH
+        h = s < 1800 ? h : fmax(750 - 1.5 * (s - 1800), 400);
+    }));
+    traces.push_back(synthetic("window opened", true, 3600, [](double s, double &c, double &h) {
+        c = s < 1803 ? 220 : 220 - 60 * (1 - exp(-(s - 1803) / 20));      // 22 to 16 C, most of it in a minute
+        h = 450;
+    }));
+    return traces;
+}
+
+// Purpose: a trace from a history_dump CSV, the valid samples of one sensor
+static bool load_csv(const char *path, unsigned sensor, Trace &trace) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    trace = {path, true, {}};
+    unsigned index;
+    unsigned time_ms;
+    unsigned channel;
+    unsigned valid;
+    int celcius;
+    unsigned humidity;
+    while (fscanf(file, "%u,%u,%u,%u,%d,%u", &index, &time_ms, &channel, &valid, &celcius, &humidity) == 6) {
+        if (channel == sensor && valid && (trace.points.empty() || time_ms > trace.points.back().time_ms)) {
+            trace.points.push_back({time_ms, (double)celcius, (double)humidity});
+        }
+    }
+    fclose(file);
+    return trace.points.size() >= 2;
+}
+
+int main(int argc, char **argv) {
+    std::vector<Trace> traces;
+    if (argc > 1) {
+        Trace trace;
+        if (!load_csv(argv[1], argc > 2 ? atoi(argv[2]) : 0, trace)) {
+            fprintf(stderr, "%s: no samples to replay\n", argv[1]);
+            return 1;
+        }
+        traces.push_back(trace);
+    }
+    else {
+        traces = synthetic_traces();
+    }
+
+    printf("range %d.%d - %d.%d C, %d.%d - %d.%d %%RH, reads every %d ms fixed, %d - %d ms adaptive\n",
+           range.temp_min / 10, range.temp_min % 10, range.temp_max / 10, range.temp_max % 10,
+           range.humidity_min / 10, range.humidity_min % 10, range.humidity_max / 10, range.humidity_max % 10, MIN_MS,
+           MIN_MS, MAX_MS);
+    printf("trace                  reads: fixed adaptive saved  crossings  delay fixed / adaptive: mean       worst"
+           "   late\n");
+    for (const Trace &trace : traces) {
+        replay(trace);
+    }
+    return check_summary();
+}
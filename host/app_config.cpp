@@ -0,0 +1,43 @@
+// Firmware settings read by the host tools from the firmware's own sources
+
+#include "app_config.h"
+#include <cstdio>
+#include <cstdlib>
+
+bool read_file(const char *path, std::string &text) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+    char buffer[512];
+    size_t n;
+    text.clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, n);
+    }
+    fclose(file);
+    return true;
+}
+
+bool config_value(const std::string &json, const char *name, uint32_t &value) {
+    size_t at = json.find(std::string("\"") + name + "\"");
+    size_t key = at == std::string::npos ? at : json.find("\"value\"", at);
+    size_t colon = key == std::string::npos ? key : json.find(':', key);
+    if (colon == std::string::npos) {
+        printf("%s: no value for %s\n", APP_CONFIG_PATH, name);
+        return false;
+    }
+    value = (uint32_t)strtoul(json.c_str() + colon + 1, nullptr, 10);
+    return true;
+}
+
+bool define_value(const std::string &source, const char *name, uint32_t &value) {
+    size_t at = source.find(std::string("#define ") + name + " ");
+    if (at == std::string::npos) {
+        printf("no #define %s\n", name);
+        return false;
+    }
+    value = (uint32_t)strtoul(source.c_str() + at + 9 + std::string(name).size(), nullptr, 10);
+    return true;
+}
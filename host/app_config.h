@@ -0,0 +1,43 @@
+// Firmware settings read by the host tools from the firmware's own sources
+//
+// The checks read mbed_app.json and the #defines they depend on at run time
+// rather than keep copies of them, so a changed setting is checked as it is.
+
+#ifndef HOST_APP_CONFIG_H
+#define HOST_APP_CONFIG_H
+
+#include <stdint.h>
+#include <string>
+
+#define APP_CONFIG_PATH "../mbed_app.json"     // relative to host/, where the tools are run from
+
+/** Read a whole file.
+ *
+ * @param path file to read
+ * @param text receives its contents
+ * @returns
+ *   false, after printing why, if the file could not be opened
+ */
+bool read_file(const char *path, std::string &text);
+
+/** Find the value of a config entry in the text of mbed_app.json.
+ *
+ * @param json contents of mbed_app.json
+ * @param name entry name without the app. prefix, e.g. "diag-sample-rate-hz"
+ * @param value receives the entry's "value"
+ * @returns
+ *   false, after printing which entry, if there is none
+ */
+bool config_value(const std::string &json, const char *name, uint32_t &value);
+
+/** Find the value of a #define in the text of a source file.
+ *
+ * @param source contents of the file
+ * @param name macro name
+ * @param value receives the leading number of its value, e.g. 1000 for 1000ms
+ * @returns
+ *   false, after printing which macro, if there is none
+ */
+bool define_value(const std::string &source, const char *name, uint32_t &value);
+
+#endif
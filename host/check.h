@@ -0,0 +1,46 @@
+// Failure counting shared by the host checks
+//
+// Each check program is a single file that includes this once: CHECK() an
+// expression, or print a FAIL line of its own and count it with failed(),
+// then return check_summary() from main().
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <cstdio>
+
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+/** Count a failure the caller has already printed.
+ *
+ * @param count failures to add
+ */
+inline void failed(int count = 1) {
+    failures += count;
+}
+
+/** Count and print a failed CHECK(). */
+inline void check(bool ok, const char *what, int line) {
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failed();
+    }
+}
+
+/** Print how the checks went.
+ *
+ * @returns
+ *   the exit status: 0 if every check passed, 1 otherwise
+ */
+inline int check_summary() {
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
+
+#endif
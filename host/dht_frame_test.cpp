@@ -0,0 +1,198 @@
+// Check the DHT frame decoding against a corpus of frames
+//
+// Each corpus frame is given as its five bytes plus the pulse widths they are
+// sent with, or as 40 raw pulse widths the way a logic analyser capture gives
+// them, and is run through the same steps as a read on the board: the pulse
+// widths through dht_decode(), the bytes through dht11_values() or
+// dht22_values(). The frames here are synthetic, built from the datasheet
+// timing; add captured frames as rows of captures[]. Also checks that every
+// single bit error in any of the four data bytes or the checksum is
+// rejected. Prints each failed check and exits non-zero if any failed.
+// Build and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. dht_frame_test.cpp ../dht_frame.cpp -o dht_frame_test
+//   ./dht_frame_test
+
+#include "check.h"
+#include "dht_frame.h"
+#include <cstdio>
+
+#define DHT11_FRAME 11
+#define DHT22_FRAME 22
+
+// one frame of the corpus, built from its bytes
+struct CorpusFrame {
+    const char *name;
+    int sensor;             // DHT11_FRAME or DHT22_FRAME
+    uint8_t bytes[5];
+    bool valid;             // whether the driver should accept it
+    int celcius;            // expected tenths, when valid
+    int humidity;
+};
+
+static const CorpusFrame corpus[] = {
+    {"DHT11 whole values",              DHT11_FRAME, {55, 0, 23, 0, 78},          true,  230, 550},
+    {"DHT11 tenths",                    DHT11_FRAME, {45, 6, 22, 7, 80},          true,  227, 456},
+    {"DHT11 negative",                  DHT11_FRAME, {60, 0, 2, 0x85, 0xC3},      true,  -25, 600},
+    {"DHT11 negative, whole degrees",   DHT11_FRAME, {70, 0, 10, 0x80, 0xD0},     true,  -100, 700},
+    {"DHT11 minus zero",                DHT11_FRAME, {80, 0, 0, 0x80, 0xD0},      true,  0, 800},
+    {"DHT11 all zero",                  DHT11_FRAME, {0, 0, 0, 0, 0},             true,  0, 0},
+    {"DHT11 top of range",              DHT11_FRAME, {95, 9, 50, 9, 163},         true,  509, 959},
+    {"DHT11 checksum off by one",       DHT11_FRAME, {55, 0, 23, 0, 79},          false, 0, 0},
+    {"DHT11 humidity decimal not 0-9",  DHT11_FRAME, {55, 10, 23, 0, 88},         false, 0, 0},
+    {"DHT11 temp decimal not 0-9",      DHT11_FRAME, {55, 0, 23, 12, 90},         false, 0, 0},
+    {"DHT11 sign bit with bad decimal", DHT11_FRAME, {55, 0, 23, 0x8A, 0xEA},     false, 0, 0},
+    // the old two byte checksum, bits[0] + bits[2], would have accepted these
+    {"DHT11 humidity decimal ignored",  DHT11_FRAME, {55, 5, 23, 0, 78},          false, 0, 0},
+    {"DHT11 temp decimal ignored",      DHT11_FRAME, {55, 0, 23, 5, 78},          false, 0, 0},
+    {"DHT22 room",                      DHT22_FRAME, {0x02, 0x8C, 0x00, 0xE6, 0x74}, true, 230, 652},
+    {"DHT22 negative, sum wraps",       DHT22_FRAME, {0x03, 0xE8, 0x80, 0xFA, 0x65}, true, -250, 1000},
+    {"DHT22 checksum without carry",    DHT22_FRAME, {0x03, 0xE8, 0x80, 0xFA, 0x66}, false, 0, 0},
+};
+
+// 40 raw pulse widths and the bytes they should decode to
+struct Capture {
+    const char *name;
+    uint8_t widths[DHT_BITS];
+    uint8_t bytes[5];
+};
+
+static const Capture captures[] = {
+    // 55 %RH 23 C with the spread of widths the datasheet allows, 0s 23-30 us and 1s 66-74 us
+    {"spread widths",
+     {28, 25, 72, 66, 24, 74, 67, 71,   23, 26, 23, 24, 29, 29, 24, 26,
+      24, 29, 23, 67, 26, 66, 72, 66,   26, 23, 25, 27, 29, 25, 24, 27,
+      25, 67, 26, 28, 67, 74, 67, 23},
+     {55, 0, 23, 0, 78}},
+    // the same frame with every pulse stretched by 20 us, as by an interrupt storm on a slow ticker: every 0 is
+    // above the nominal 40 us cutoff
+    {"stretched 20 us",
+     {48, 45, 92, 86, 44, 94, 87, 91,   43, 46, 43, 44, 49, 49, 44, 46,
+      44, 49, 43, 87, 46, 86, 92, 86,   46, 43, 45, 47, 49, 45, 44, 47,
+      45, 87, 46, 48, 87, 94, 87, 43},
+     {55, 0, 23, 0, 78}},
+};
+
+// Purpose: the pulse widths a sensor sends for these bytes
+static void widths_for(const uint8_t bytes[5], uint8_t zero_us, uint8_t one_us, uint8_t widths[DHT_BITS]) {
+    for (int i = 0; i < DHT_BITS; i++) {
+        widths[i] = (bytes[i / 8] >> (7 - i % 8)) & 1 ? one_us : zero_us;
+    }
+}
+
+// Purpose: the driver's verdict on a frame's bytes
+static bool values(int sensor, const uint8_t bytes[5], int &celcius, int &humidity) {
+    return sensor == DHT11_FRAME ? dht11_values(bytes, celcius, humidity) : dht22_values(bytes, celcius, humidity);
+}
+
+// Purpose: every corpus frame decodes from its pulses to the expected bytes, and the driver accepts or rejects it
+static void test_corpus() {
+    for (const CorpusFrame &frame : corpus) {
+        uint8_t widths[DHT_BITS];
+        widths_for(frame.bytes, 27, 70, widths);
+        DHTFrame decoded;
+        dht_decode(widths, decoded);
+        bool bytes_ok = true;
+        for (int i = 0; i < 5; i++) {
+            bytes_ok = bytes_ok && decoded.bits[i] == frame.bytes[i];
+        }
+
+        int celcius = 12345;
+        int humidity = 12345;
+        bool accepted = values(frame.sensor, decoded.bits, celcius, humidity);
+        bool ok = bytes_ok && accepted == frame.valid;
+        if (frame.valid) {
+            ok = ok && celcius == frame.celcius && humidity == frame.humidity;
+        }
+        else {
+            ok = ok && celcius == 12345 && humidity == 12345;      // nothing written for a rejected frame
+        }
+        if (!ok) {
+            printf("FAIL %s: bytes %s, %s, %d.%d C %d.%d %%RH\n", frame.name, bytes_ok ? "ok" : "wrong",
+                   accepted ? "accepted" : "rejected", celcius / 10, celcius % 10, humidity / 10, humidity % 10);
+            failed();
+        }
+    }
+}
+
+// Purpose: captured widths decode to their bytes with a cutoff between the clusters
+static void test_captures() {
+    for (const Capture &capture : captures) {
+        DHTFrame decoded;
+        dht_decode(capture.widths, decoded);
+        bool ok = true;
+        for (int i = 0; i < 5; i++) {
+            ok = ok && decoded.bits[i] == capture.bytes[i];
+        }
+        if (!ok) {
+            printf("FAIL %s: decoded %u %u %u %u %u, cutoff %u us\n", capture.name, decoded.bits[0], decoded.bits[1],
+                   decoded.bits[2], decoded.bits[3], decoded.bits[4], decoded.threshold);
+            failed();
+        }
+    }
+}
+
+// Purpose: the cutoff and the confidence of clean, single cluster, marginal and stretched frames
+static void test_confidence() {
+    const uint8_t bytes[5] = {55, 0, 23, 0, 78};
+    uint8_t widths[DHT_BITS];
+    DHTFrame decoded;
+
+    widths_for(bytes, 27, 70, widths);
+    CHECK(dht_decode(widths, decoded));
+    CHECK(decoded.threshold > 27 && decoded.threshold < 70);
+    CHECK(decoded.confidence == 100);
+
+    // all 0s: one cluster, the nominal cutoff is used
+    const uint8_t zeros[5] = {0, 0, 0, 0, 0};
+    widths_for(zeros, 27, 70, widths);
+    dht_decode(widths, decoded);
+    CHECK(decoded.threshold == DHT_NOMINAL_THRESHOLD);
+
+    // a short 1 narrows the gap between the clusters, which lowers the confidence but not the decode
+    widths_for(bytes, 27, 70, widths);
+    widths[2] = 50;                     // the cutoff is centered in the gap, at 38 us
+    CHECK(dht_decode(widths, decoded));
+    CHECK(decoded.bits[0] == 55);
+    CHECK(decoded.threshold == 38);
+    CHECK(decoded.confidence < 60);
+
+    // with a long 0 as well the gap is 4 us, either pulse could be the other bit
+    widths[0] = 46;
+    CHECK(!dht_decode(widths, decoded));
+
+    // a single 1 stretched far out by an interrupt does not drag the cutoff past the other 1s
+    widths_for(bytes, 27, 70, widths);
+    widths[2] = 160;
+    CHECK(dht_decode(widths, decoded));
+    CHECK(decoded.bits[0] == 55);
+}
+
+// Purpose: every single bit error in the frame is caught by the checksum over all four data bytes
+static void test_checksum_coverage() {
+    const uint8_t good[5] = {45, 6, 22, 7, 80};
+    int celcius;
+    int humidity;
+    CHECK(dht_checksum_ok(good));
+    int missed = 0;
+    for (int byte = 0; byte < 5; byte++) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t bytes[5] = {good[0], good[1], good[2], good[3], good[4]};
+            bytes[byte] ^= 1 << bit;
+            if (dht_checksum_ok(bytes) || dht11_values(bytes, celcius, humidity) ||
+                dht22_values(bytes, celcius, humidity)) {
+                printf("FAIL bit %d of byte %d flipped and accepted\n", bit, byte);
+                missed++;
+            }
+        }
+    }
+    failed(missed);
+}
+
+int main() {
+    test_corpus();
+    test_captures();
+    test_confidence();
+    test_checksum_coverage();
+    return check_summary();
+}
@@ -0,0 +1,158 @@
+// Fuzz the DHT bit decoding with pulse width jitter and noise
+//
+// Builds random valid DHT11 frames, sends each as pulse widths around the
+// nominal ~27 us (0) and ~70 us (1) with every pulse moved by a random
+// jitter, the whole frame optionally stretched, and now and then one pulse
+// replaced by noise, then decodes it like a read on the board. Each frame
+// ends up correct, rejected (a pulse on the cutoff, the checksum or a
+// decimal) or wrong (accepted with a different reading). Prints the rates
+// against jitter and stretch, for the adaptive cutoff and for the old fixed
+// 40 us one.
+//
+// The decoder is only meant to tell two clusters apart, so the check is on
+// the frames whose 0s and 1s, the noise pulse left out, are still at least
+// DHT_MIN_SEPARATION apart: each of them must decode correctly or be
+// rejected, never be accepted with a wrong reading. Once the jitter makes
+// the clusters run into each other the table shows how often that still
+// happens. Build and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. dht_fuzz.cpp ../dht_frame.cpp -o dht_fuzz
+//   ./dht_fuzz [frames per row]
+
+#include "check.h"
+#include "dht_frame.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#define ZERO_US 27
+#define ONE_US 70
+#define NOISE_PERCENT 5         // frames with one pulse replaced by a random width
+
+static std::mt19937 rng(1);
+
+// Purpose: uniform random integer in [low, high]
+static int uniform(int low, int high) {
+    return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+// Purpose: a random valid DHT11 frame and the reading it carries
+static void random_frame(uint8_t bytes[5], int &celcius, int &humidity) {
+    bool negative = uniform(0, 9) == 0;
+    bytes[0] = uniform(20, 95);
+    bytes[1] = uniform(0, 9);
+    bytes[2] = uniform(0, 50);
+    bytes[3] = uniform(0, 9) | (negative ? 0x80 : 0);
+    bytes[4] = bytes[0] + bytes[1] + bytes[2] + bytes[3];
+    humidity = bytes[0] * 10 + bytes[1];
+    celcius = (bytes[2] * 10 + (bytes[3] & 0x7F)) * (negative ? -1 : 1);
+}
+
+// Purpose: the old decoder, every pulse against a fixed 40 us cutoff
+static void fixed_decode(const uint8_t widths[DHT_BITS], uint8_t bits[5]) {
+    for (int i = 0; i < 5; i++) bits[i] = 0;
+    for (int i = 0; i < DHT_BITS; i++) {
+        if (widths[i] > 40) bits[i / 8] |= 1 << (7 - i % 8);
+    }
+}
+
+// outcome counts for one row of the table
+struct Outcomes {
+    unsigned long correct;
+    unsigned long rejected;
+    unsigned long wrong;
+};
+
+// Purpose: classify one decoded frame against the reading that was sent
+static void classify(const uint8_t bits[5], int celcius, int humidity, Outcomes &outcomes) {
+    int decoded_celcius;
+    int decoded_humidity;
+    if (!dht11_values(bits, decoded_celcius, decoded_humidity)) {
+        outcomes.rejected++;
+    }
+    else if (decoded_celcius == celcius && decoded_humidity == humidity) {
+        outcomes.correct++;
+    }
+    else {
+        outcomes.wrong++;
+    }
+}
+
+// Purpose: print a row of rates in percent
+static void print_rates(const Outcomes &outcomes, unsigned long frames) {
+    printf("  %6.2f %6.2f %6.3f", 100.0 * outcomes.correct / frames, 100.0 * outcomes.rejected / frames,
+           100.0 * outcomes.wrong / frames);
+}
+
+int main(int argc, char **argv) {
+    unsigned long frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+    unsigned long separated = 0;
+    unsigned long separated_correct = 0;
+    unsigned long separated_wrong = 0;
+
+    printf("jitter stretch |  adaptive: correct rejected wrong %% |  fixed 40 us: correct rejected wrong %%\n");
+    for (int stretch = -10; stretch <= 20; stretch += 10) {
+        for (int jitter = 0; jitter <= 24; jitter += 4) {
+            Outcomes adaptive = {0, 0, 0};
+            Outcomes fixed = {0, 0, 0};
+            for (unsigned long n = 0; n < frames; n++) {
+                uint8_t bytes[5];
+                int celcius;
+                int humidity;
+                random_frame(bytes, celcius, humidity);
+
+                uint8_t widths[DHT_BITS];
+                int longest_zero = -1;
+                int shortest_one = 256;
+                for (int i = 0; i < DHT_BITS; i++) {
+                    bool one = (bytes[i / 8] >> (7 - i % 8)) & 1;
+                    int width = (one ? ONE_US : ZERO_US) + stretch + uniform(-jitter, jitter);
+                    width = width < 1 ? 1 : width > 255 ? 255 : width;
+                    widths[i] = width;
+                }
+                int noise = -1;
+                if (uniform(1, 100) <= NOISE_PERCENT) {
+                    noise = uniform(0, DHT_BITS - 1);
+                    widths[noise] = uniform(1, 120);
+                }
+                for (int i = 0; i < DHT_BITS; i++) {
+                    bool one = (bytes[i / 8] >> (7 - i % 8)) & 1;
+                    if (i == noise) continue;
+                    if (one && widths[i] < shortest_one) shortest_one = widths[i];
+                    if (!one && widths[i] > longest_zero) longest_zero = widths[i];
+                }
+
+                DHTFrame frame;
+                Outcomes before = adaptive;
+                if (dht_decode(widths, frame)) {
+                    classify(frame.bits, celcius, humidity, adaptive);
+                }
+                else {
+                    adaptive.rejected++;
+                }
+                if (shortest_one - longest_zero >= DHT_MIN_SEPARATION) {
+                    separated++;
+                    separated_correct += adaptive.correct - before.correct;
+                    if (adaptive.wrong != before.wrong && separated_wrong++ < 5) {
+                        printf("FAIL clusters %d us apart and accepted with a wrong reading, cutoff %u us\n",
+                               shortest_one - longest_zero, frame.threshold);
+                    }
+                }
+
+                uint8_t bits[5];
+                fixed_decode(widths, bits);
+                classify(bits, celcius, humidity, fixed);
+            }
+            printf("%4d us %4d us |", jitter, stretch);
+            print_rates(adaptive, frames);
+            printf("              |");
+            print_rates(fixed, frames);
+            printf("\n");
+        }
+    }
+
+    printf("clusters at least %d us apart: %lu frames, %.2f %% correct, %lu accepted with a wrong reading\n",
+           DHT_MIN_SEPARATION, separated, 100.0 * separated_correct / separated, separated_wrong);
+    failed(separated_wrong);
+    return check_summary();
+}
@@ -0,0 +1,183 @@
+// Evaluate the energy estimate from a console capture
+//
+// The text diagnostics report prints the counters behind the energy estimate
+// in full (energy_report() in energy.cpp). This reads a capture of the
+// console, rebuilds the counters of every report and evaluates them with the
+// model from ../mbed_app.json, each energy-* value optionally replaced on the
+// command line, so other currents can be tried without flashing the board.
+// Prints one line per report: the average the device gave, the average from
+// mbed_app.json and from the changed model, both since boot and over the
+// interval since the previous report, then where the charge went from boot
+// to the last report. Build and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. energy_eval.cpp app_config.cpp ../energy_model.cpp -o energy_eval
+//   ./energy_eval console.log [stop-ua=5 backlight-ua=0 ...]
+
+#include "app_config.h"
+#include "energy_model.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// an mbed_app.json energy-* entry and where it goes in the model
+struct ModelEntry {
+    const char *name;           // without the energy- prefix
+    uint32_t EnergyModel::*field;
+};
+
+static const ModelEntry entries[] = {
+    {"run-ua", &EnergyModel::run_ua},
+    {"sleep-ua", &EnergyModel::sleep_ua},
+    {"stop-ua", &EnergyModel::stop_ua},
+    {"backlight-ua", &EnergyModel::backlight_ua},
+    {"buzzer-ua", &EnergyModel::buzzer_ua},
+    {"led-ua", &EnergyModel::led_ua},
+    {"sensor-idle-ua", &EnergyModel::sensor_idle_ua},
+    {"sensor-read-uc", &EnergyModel::sensor_read_uc},
+    {"i2c-byte-nc", &EnergyModel::i2c_byte_nc},
+};
+
+// Purpose: find an entry by name, nullptr if there is none
+static const ModelEntry *find_entry(const char *name, size_t length) {
+    for (const ModelEntry &entry : entries) {
+        if (strlen(entry.name) == length && strncmp(entry.name, name, length) == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// Purpose: read every energy-* value from mbed_app.json, false if the file or an entry is missing
+static bool load_model(EnergyModel &model) {
+    std::string json;
+    if (!read_file(APP_CONFIG_PATH, json)) {
+        return false;
+    }
+    for (const ModelEntry &entry : entries) {
+        if (!config_value(json, (std::string("energy-") + entry.name).c_str(), model.*entry.field)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Purpose: apply name=value arguments to the model, false on one that is not an energy-* entry
+static bool change_model(int count, char **arguments, EnergyModel &model) {
+    for (int i = 0; i < count; i++) {
+        const char *equals = strchr(arguments[i], '=');
+        const ModelEntry *entry = equals ? find_entry(arguments[i], equals - arguments[i]) : nullptr;
+        if (entry == nullptr) {
+            printf("%s: expected <entry>=<value>, entries are", arguments[i]);
+            for (const ModelEntry &known : entries) {
+                printf(" %s", known.name);
+            }
+            printf("\n");
+            return false;
+        }
+        model.*entry->field = (uint32_t)strtoul(equals + 1, nullptr, 10);
+    }
+    return true;
+}
+
+// Purpose: print an average current and its charge per day
+static void print_average(uint32_t average_ua) {
+    uint32_t per_day = energy_per_day(average_ua);
+    printf("  %7lu %5lu.%lu", (unsigned long)average_ua, (unsigned long)(per_day / 10), (unsigned long)(per_day % 10));
+}
+
+// Purpose: print the share of the average each component draws under the model
+static void print_breakdown(const ActivityCounters &counters, const EnergyModel &model) {
+    uint32_t total = energy_average_ua(counters, model);
+    printf("where the charge went over %lu s, %lu uA in all:\n", (unsigned long)(counters.window_ms / 1000),
+           (unsigned long)total);
+    for (const ModelEntry &entry : entries) {
+        EnergyModel alone = {};
+        alone.*entry.field = model.*entry.field;
+        uint32_t part = energy_average_ua(counters, alone);
+        printf("  %-15s %7lu uA  %5.1f %%\n", entry.name, (unsigned long)part, total ? 100.0 * part / total : 0.0);
+    }
+}
+
+int main(int argc, char **argv) {
+    FILE *input = argc > 1 && strcmp(argv[1], "-") != 0 ? fopen(argv[1], "r") : stdin;
+    if (input == nullptr) {
+        perror(argv[1]);
+        return 1;
+    }
+    EnergyModel configured;
+    if (!load_model(configured)) {
+        return 1;
+    }
+    EnergyModel changed = configured;
+    bool changes = argc > 2;
+    if (!change_model(argc - 2, argv + 2, changed)) {
+        return 1;
+    }
+
+    printf("uptime s | device uA | mbed_app.json: uA mAh/day, interval uA mAh/day%s\n",
+           changes ? " | changed: uA mAh/day, interval uA mAh/day" : "");
+    ActivityCounters counters = {};
+    ActivityCounters previous = {};
+    int stage = 0;          // report lines read so far: the run, sleep and stop line, then the outputs line
+    unsigned long reports = 0;
+    unsigned long differ = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), input)) {
+        unsigned long a, b, c, d, e, f;
+        const char *at;
+        if ((at = strstr(line, "energy: run ")) &&
+            sscanf(at, "energy: run %lu ms, sleep %lu ms, stop %lu ms of %lu ms", &a, &b, &c, &d) == 4) {
+            counters.run_ms = a;
+            counters.sleep_ms = b;
+            counters.stop_ms = c;
+            counters.window_ms = d;
+            stage = 1;
+        }
+        else if (stage == 1 && (at = strstr(line, "backlight ")) &&
+                 sscanf(at, "backlight %lu ms, buzzer %lu ms, led %lu ms, i2c %lu B, %lu reads of %lu sensors", &a,
+                        &b, &c, &d, &e, &f) == 6) {
+            counters.backlight_ms = a;
+            counters.buzzer_ms = b;
+            counters.led_ms = c;
+            counters.i2c_bytes = d;
+            counters.sensor_reads = e;
+            counters.sensors = f;
+            stage = 2;
+        }
+        else if (stage == 2 && (at = strstr(line, "average ")) && sscanf(at, "average %lu uA", &a) == 1) {
+            if (counters.window_ms < previous.window_ms) {
+                previous = {};      // the board restarted
+            }
+            ActivityCounters interval = energy_interval(counters, previous);
+            uint32_t average = energy_average_ua(counters, configured);
+            differ += average != a;
+            printf("%8lu | %9lu |", (unsigned long)(counters.window_ms / 1000), a);
+            print_average(average);
+            print_average(energy_average_ua(interval, configured));
+            if (changes) {
+                printf(" |");
+                print_average(energy_average_ua(counters, changed));
+                print_average(energy_average_ua(interval, changed));
+            }
+            printf("\n");
+            previous = counters;
+            reports++;
+            stage = 0;
+        }
+    }
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    if (reports == 0) {
+        printf("no energy reports found, telemetry-enabled has to be false for the text report\n");
+        return 1;
+    }
+    print_breakdown(previous, changed);
+    if (differ) {
+        printf("%lu of %lu reports differ from %s: the board was built with other energy-* values\n", differ,
+               reports, APP_CONFIG_PATH);
+    }
+    return 0;
+}
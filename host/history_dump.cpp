@@ -0,0 +1,172 @@
+// Pull the climate monitor's stored sample history over the serial port
+//
+// Asks for the history a window of chunks at a time (COMMAND_HISTORY) and
+// appends every entry to a CSV file, one line per sample:
+//
+//   index,time_ms,sensor,valid,celcius,humidity      (readings in tenths)
+//
+// Each request carries the index of the next entry wanted, so it is both the
+// acknowledgement of the chunks before it and the flow control: the device
+// never sends more than one window ahead. A chunk that is lost or damaged
+// makes the chunks behind it arrive out of order; they are ignored and the
+// window is asked for again from the missing entry straight away, or after
+// REPLY_TIMEOUT_MS if nothing arrives at all. An existing file is resumed
+// after its last line. Stops once the entries stored when the dump started
+// have all been written, and prints the effective throughput against the
+// raw baud rate.
+//
+// Needs the device built with "telemetry-enabled": true. POSIX only. Build
+// and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. history_dump.cpp serial_port.cpp ../frame.cpp ../telemetry_record.cpp -o history_dump
+//   ./history_dump /dev/ttyACM0 115200 history.csv
+
+#include "serial_port.h"
+#include "frame.h"
+#include "telemetry_record.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#define WINDOW_CHUNKS 8         // chunks asked for at once
+#define REPLY_TIMEOUT_MS 500    // silence after which the window is asked for again
+#define MAX_FRAME 512
+
+typedef std::chrono::steady_clock Clock;
+
+// Purpose: index after the last line of an existing file, 0 for a new one
+static uint32_t resume_offset(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    char line[128];
+    long last = -1;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        last = strtol(line, nullptr, 10);
+    }
+    fclose(file);
+    return last < 0 ? 0 : (uint32_t)last + 1;
+}
+
+// Purpose: ask for a window of chunks from offset
+static bool request(int fd, uint32_t offset) {
+    static uint16_t tag = 0;
+    uint8_t buffer[FRAME_ENCODED_SIZE(8)];
+    FrameEncoder frame(buffer, sizeof(buffer));
+    frame.put(COMMAND_HISTORY);
+    frame.put_u16(tag++);
+    frame.put_u32(offset);
+    frame.put(WINDOW_CHUNKS);
+    size_t length = frame.finish();
+    return write(fd, buffer, length) == (ssize_t)length;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <port> <baud> <file.csv>\n", argv[0]);
+        return 2;
+    }
+    long baud = strtol(argv[2], nullptr, 10);
+    int fd = serial_open(argv[1], baud);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    uint32_t next = resume_offset(argv[3]);
+    FILE *out = fopen(argv[3], "a");
+    if (out == nullptr) {
+        perror(argv[3]);
+        return 1;
+    }
+
+    uint8_t rx[MAX_FRAME];
+    FrameReceiver receiver(rx, sizeof(rx));
+    HistoryChunk chunk;
+    bool started = false;
+    uint32_t stop = 0;              // end of the history when the dump started
+    unsigned long entries = 0, skipped = 0, bad = 0, retries = 0, wire_bytes = 0;
+    int window = 0;                 // chunks still to come in this window
+    bool resent = false;            // this window was already asked for again after a lost chunk
+    Clock::time_point begin = Clock::now();
+    Clock::time_point last_reply = begin;
+
+    request(fd, next);
+    window = WINDOW_CHUNKS;
+    while (!started || next < stop) {
+        uint8_t buffer[256];
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count < 0) {
+            perror("read");
+            return 1;
+        }
+        wire_bytes += count;
+        for (ssize_t i = 0; i < count; i++) {
+            int length = receiver.put(buffer[i]);
+            if (length == -1) {
+                bad++;
+            }
+            uint16_t sequence;
+            if (length <= 0 || !telemetry_parse_history(rx, length, sequence, chunk)) {
+                continue;   // damaged, or the telemetry stream going on meanwhile
+            }
+            last_reply = Clock::now();
+            window--;
+            if (chunk.end < next) {
+                fprintf(stderr, "device restarted, its history now ends at %u\n", chunk.end);
+                return 1;
+            }
+            if (!started) {
+                started = true;
+                stop = chunk.end;
+                fprintf(stderr, "dumping %u to %u\n", next, stop);
+            }
+            if (chunk.offset > next && chunk.offset == chunk.first) {
+                skipped += chunk.offset - next;     // overwritten before it was dumped
+                next = chunk.offset;
+            }
+            if (chunk.offset != next) {
+                // behind a lost chunk: start over from it once, the rest of this window is ignored as it comes
+                if (!resent && chunk.offset > next) {
+                    retries++;
+                    request(fd, next);
+                    window = WINDOW_CHUNKS;
+                    resent = true;
+                }
+                continue;
+            }
+            for (uint8_t e = 0; e < chunk.count; e++) {
+                const HistoryEntry &entry = chunk.entries[e];
+                fprintf(out, "%u,%u,%u,%u,%d,%u\n", next + e, entry.time_ms, entry.sensor, entry.valid,
+                        entry.celcius, entry.humidity);
+            }
+            next += chunk.count;
+            entries += chunk.count;
+            if (chunk.count == 0) {
+                window = 0;     // caught up, nothing more is coming in this window
+            }
+        }
+
+        long quiet_ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - last_reply).count();
+        if ((window <= 0 || quiet_ms > REPLY_TIMEOUT_MS) && (!started || next < stop)) {
+            if (window > 0) {
+                retries++;
+            }
+            request(fd, next);
+            window = WINDOW_CHUNKS;
+            resent = false;
+            last_reply = Clock::now();
+        }
+    }
+    fclose(out);
+
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    double raw = baud / 10.0;       // 8N1: ten bits per byte
+    double effective = entries * HISTORY_ENTRY_SIZE / seconds;
+    fprintf(stderr, "%lu entries in %.2f s, %lu overwritten before the dump, %lu bad frames, %lu retries\n", entries,
+            seconds, skipped, bad, retries);
+    fprintf(stderr, "%.0f B/s of entries, %.0f B/s on the wire, raw %.0f B/s: %.0f %% of the baud rate\n", effective,
+            wire_bytes / seconds, raw, 100 * effective / raw);
+    return 0;
+}
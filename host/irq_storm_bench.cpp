@@ -0,0 +1,293 @@
+// Benchmark DHT reads under an interrupt storm
+//
+// Simulates t_monitor timing a DHT11 frame by busy-waiting on the pin, one
+// step per us, while interrupts arrive at random: a storm at the keypad's
+// priority (a bouncing key or a noisy column line), and serial receive
+// interrupts above it at 115200 baud. While an ISR runs the loop does not
+// look at the pin, so an edge is only seen once it returns: a pulse whose
+// edge falls in an ISR is measured too long or too short, and one that is
+// entirely covered is missed and the rest of the frame slips. The widths go
+// through dht_decode() and dht11_values() like a read on the board.
+//
+// Prints the share of reads that fail (timeout, rejected) or are accepted
+// with a wrong reading against the storm rate, with the frame unmasked and
+// with the fixed 40 us cutoff of the old driver, unmasked, and inside an
+// IrqWindow at sensor-mask-priority. In the window the keypad edges are
+// latched as pending, one per column line as in the NVIC, while the serial
+// interrupts still run; when the window closes the pending ISRs run back to
+// back. Next to each row it prints what that costs the keypad: the mean and
+// worst latency from an edge to its ISR starting, unmasked and masked, and
+// the share of edges that fell on a line already pending. Build and run
+// from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. irq_storm_bench.cpp ../dht_frame.cpp -o irq_storm_bench
+//   ./irq_storm_bench [reads per row]
+
+#include "dht_frame.h"
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#define LOW_US 50               // low between bits
+#define ZERO_US 27
+#define ONE_US 70
+#define ACK_US 80               // the sensor's low and high acknowledge
+#define TIMEOUT_US 500          // a level held this long ends the read, as the driver's loop counter does
+#define STORM_ISR_US 8          // keypad column ISR, debounce and queueing
+#define SERIAL_RATE 11520       // receive interrupts per second, 115200 baud with every byte arriving
+#define SERIAL_ISR_US 2
+#define START_US 40             // the start signal, sent with the window already open
+#define KEYPAD_LINES 4          // column EXTI lines, each latches one pending edge
+
+static std::mt19937 rng(1);
+
+// Purpose: uniform random integer in [low, high]
+static int uniform(int low, int high) {
+    return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+// Purpose: a random valid DHT11 frame and the reading it carries
+static void random_frame(uint8_t bytes[5], int &celcius, int &humidity) {
+    bytes[0] = uniform(20, 95);
+    bytes[1] = uniform(0, 9);
+    bytes[2] = uniform(0, 50);
+    bytes[3] = uniform(0, 9);
+    bytes[4] = bytes[0] + bytes[1] + bytes[2] + bytes[3];
+    humidity = bytes[0] * 10 + bytes[1];
+    celcius = bytes[2] * 10 + bytes[3];
+}
+
+// Purpose: mark the us spent in ISRs arriving at rate per second, each running isr_us, back to back when they queue
+static void add_interrupts(std::vector<bool> &busy, double rate, int isr_us) {
+    if (rate <= 0) return;
+    std::exponential_distribution<double> gap(rate / 1e6);
+    int free_at = 0;
+    for (double t = gap(rng); t < busy.size(); t += gap(rng)) {
+        int start = (int)t > free_at ? (int)t : free_at;
+        for (int i = start; i < start + isr_us && i < (int)busy.size(); i++) {
+            busy[i] = true;
+        }
+        free_at = start + isr_us;
+    }
+}
+
+// a keypad edge, the us it arrives at and the column line it arrives on
+struct Edge {
+    int time;
+    int line;
+};
+
+// Purpose: keypad edges arriving at rate per second over length us
+static std::vector<Edge> storm_edges(double rate, int length) {
+    std::vector<Edge> edges;
+    if (rate <= 0) return edges;
+    std::exponential_distribution<double> gap(rate / 1e6);
+    for (double t = gap(rng); t < length; t += gap(rng)) {
+        edges.push_back({(int)t, uniform(0, KEYPAD_LINES - 1)});
+    }
+    return edges;
+}
+
+// latency from a keypad edge to its ISR starting
+struct Latency {
+    unsigned long edges;
+    unsigned long coalesced;        // edges on a line that was already pending, served by the same ISR
+    double total_us;
+    int worst_us;
+
+    void add(int latency_us) {
+        edges++;
+        total_us += latency_us;
+        worst_us = std::max(worst_us, latency_us);
+    }
+};
+
+// Purpose: run the storm ISRs as the edges arrive, back to back when they queue, marking busy and the latency
+static void run_unmasked(const std::vector<Edge> &edges, std::vector<bool> &busy, Latency &latency) {
+    int free_at = 0;
+    for (const Edge &edge : edges) {
+        int start = std::max(edge.time, free_at);
+        for (int i = start; i < start + STORM_ISR_US && i < (int)busy.size(); i++) {
+            busy[i] = true;
+        }
+        latency.add(start - edge.time);
+        free_at = start + STORM_ISR_US;
+    }
+}
+
+// Purpose: latch the edges that arrive before the window closes, one per line, run the pending ISRs back to back
+// at close and the later edges as they arrive
+static void run_masked(const std::vector<Edge> &edges, int close, Latency &latency) {
+    int pending_since[KEYPAD_LINES];
+    for (int &since : pending_since) since = -1;
+    size_t next = 0;
+    for (; next < edges.size() && edges[next].time < close; next++) {
+        const Edge &edge = edges[next];
+        if (pending_since[edge.line] >= 0) {
+            latency.coalesced++;
+            latency.add(close - edge.time);     // seen by the ISR its line already has pending
+        }
+        else {
+            pending_since[edge.line] = edge.time;
+        }
+    }
+    int free_at = close;
+    for (int line = 0; line < KEYPAD_LINES; line++) {
+        if (pending_since[line] >= 0) {
+            latency.add(free_at - pending_since[line]);
+            free_at += STORM_ISR_US;
+        }
+    }
+    for (; next < edges.size(); next++) {
+        int start = std::max(edges[next].time, free_at);
+        latency.add(start - edges[next].time);
+        free_at = start + STORM_ISR_US;
+    }
+}
+
+// Purpose: the old decoder, every pulse against a fixed 40 us cutoff
+static void fixed_decode(const uint8_t widths[DHT_BITS], uint8_t bits[5]) {
+    for (int i = 0; i < 5; i++) bits[i] = 0;
+    for (int i = 0; i < DHT_BITS; i++) {
+        if (widths[i] > 40) bits[i / 8] |= 1 << (7 - i % 8);
+    }
+}
+
+// the busy-wait loop of DHTBus::read_frame(), stepping through the pin one us at a time
+class Reader {
+public:
+    Reader(const std::vector<bool> &pin, const std::vector<bool> &busy) : _pin(pin), _busy(busy), _now(START_US) {}
+
+    // Purpose: wait while the pin reads level, false on timeout
+    bool wait_while(bool level) {
+        int since = _now;
+        for (;;) {
+            while (_now < (int)_busy.size() && _busy[_now]) _now++;      // in an ISR, the pin is not looked at
+            if (_now >= (int)_pin.size() || _now - since > TIMEOUT_US) return false;
+            if (_pin[_now] != level) return true;
+            _now++;
+        }
+    }
+
+    int now() const { return _now; }
+
+private:
+    const std::vector<bool> &_pin;
+    const std::vector<bool> &_busy;
+    int _now;
+};
+
+// outcome counts for one row of the table
+struct Outcomes {
+    unsigned long failed;
+    unsigned long wrong;
+};
+
+// Purpose: read one frame from the pin, decode it and count the outcome, returns the us the read ended at
+static int read_frame(const std::vector<bool> &pin, const std::vector<bool> &busy, bool fixed, int celcius,
+                       int humidity, Outcomes &outcomes) {
+    Reader reader(pin, busy);
+    uint8_t widths[DHT_BITS];
+    bool ok = reader.wait_while(false) && reader.wait_while(true);
+    for (int i = 0; ok && i < DHT_BITS; i++) {
+        ok = reader.wait_while(false);
+        int rise = reader.now();
+        ok = ok && reader.wait_while(true);
+        int width = reader.now() - rise;
+        widths[i] = width > 255 ? 255 : width;
+    }
+    if (!ok) {
+        outcomes.failed++;
+        return reader.now();
+    }
+
+    uint8_t bits[5];
+    if (fixed) {
+        fixed_decode(widths, bits);
+    }
+    else {
+        DHTFrame frame;
+        if (!dht_decode(widths, frame)) {
+            outcomes.failed++;
+            return reader.now();
+        }
+        for (int i = 0; i < 5; i++) bits[i] = frame.bits[i];
+    }
+    int decoded_celcius;
+    int decoded_humidity;
+    if (!dht11_values(bits, decoded_celcius, decoded_humidity)) {
+        outcomes.failed++;
+    }
+    else if (decoded_celcius != celcius || decoded_humidity != humidity) {
+        outcomes.wrong++;
+    }
+    return reader.now();
+}
+
+// Purpose: print the failed and wrong rates in percent
+static void print_rates(const Outcomes &outcomes, unsigned long reads) {
+    printf("  %6.2f %6.3f   ", 100.0 * outcomes.failed / reads, 100.0 * outcomes.wrong / reads);
+}
+
+// Purpose: print the mean and worst keypad latency in us
+static void print_latency(const Latency &latency) {
+    printf("  %6.1f %5d", latency.edges ? latency.total_us / latency.edges : 0.0, latency.worst_us);
+}
+
+int main(int argc, char **argv) {
+    unsigned long reads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 5000;
+    const double storm_rates[] = {0, 1000, 5000, 10000, 20000, 50000};
+
+    printf("storm/s | unmasked: failed wrong %% | fixed 40 us: failed wrong %% | masked: failed wrong %% "
+           "| keypad latency unmasked: mean worst us | masked: mean worst us coalesced %%\n");
+    for (double storm : storm_rates) {
+        Outcomes unmasked = {0, 0};
+        Outcomes fixed = {0, 0};
+        Outcomes masked = {0, 0};
+        Latency unmasked_latency = {0, 0, 0, 0};
+        Latency masked_latency = {0, 0, 0, 0};
+        for (unsigned long n = 0; n < reads; n++) {
+            uint8_t bytes[5];
+            int celcius;
+            int humidity;
+            random_frame(bytes, celcius, humidity);
+
+            // the start signal, then the line as the sensor drives it, 2 us of spread on every pulse, then idle low
+            std::vector<bool> pin(START_US, true);
+            pin.insert(pin.end(), ACK_US, false);
+            pin.insert(pin.end(), ACK_US, true);
+            for (int i = 0; i < DHT_BITS; i++) {
+                bool one = (bytes[i / 8] >> (7 - i % 8)) & 1;
+                pin.insert(pin.end(), LOW_US + uniform(-2, 2), false);
+                pin.insert(pin.end(), (one ? ONE_US : ZERO_US) + uniform(-2, 2), true);
+            }
+            pin.insert(pin.end(), LOW_US + TIMEOUT_US, false);
+
+            std::vector<bool> serial(pin.size(), false);
+            add_interrupts(serial, SERIAL_RATE, SERIAL_ISR_US);
+            std::vector<Edge> edges = storm_edges(storm, pin.size());
+            std::vector<bool> all = serial;
+            run_unmasked(edges, all, unmasked_latency);
+
+            read_frame(pin, all, false, celcius, humidity, unmasked);
+            read_frame(pin, all, true, celcius, humidity, fixed);
+            // the window holds the storm off the read entirely, its edges wait for the read to end
+            int close = read_frame(pin, serial, false, celcius, humidity, masked);
+            run_masked(edges, close, masked_latency);
+        }
+        printf("%7.0f |", storm);
+        print_rates(unmasked, reads);
+        printf("        |");
+        print_rates(fixed, reads);
+        printf("          |");
+        print_rates(masked, reads);
+        printf("      |");
+        print_latency(unmasked_latency);
+        printf("                          |");
+        print_latency(masked_latency);
+        printf("  %6.2f\n", masked_latency.edges ? 100.0 * masked_latency.coalesced / masked_latency.edges : 0.0);
+    }
+    return 0;
+}
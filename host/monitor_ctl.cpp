@@ -0,0 +1,201 @@
+// Query and configure the climate monitor over the serial port
+//
+// Sends one command (telemetry_record.h), waits for its reply and prints the
+// values with the round trip time, and the part of it the device spent
+// handling the command. With -n the command is repeated and the round trip
+// is summarised instead. Telemetry frames arriving meanwhile are skipped.
+//
+// Needs the device built with "telemetry-enabled": true. POSIX only. Build
+// and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. monitor_ctl.cpp serial_port.cpp ../frame.cpp ../telemetry_record.cpp -o monitor_ctl
+//   ./monitor_ctl /dev/ttyACM0 115200 thresholds 18.0 26.0 40.0 60.0
+//   ./monitor_ctl /dev/ttyACM0 115200 -n 100 stats
+
+#include "serial_port.h"
+#include "frame.h"
+#include "telemetry_record.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#define REPLY_TIMEOUT_MS 1000
+#define MAX_FRAME 512
+
+typedef std::chrono::steady_clock Clock;
+
+// Purpose: print the usage and fail
+static int usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s <port> <baud> [-n count] <command>\n"
+            "  thresholds [temp_min temp_max humidity_min humidity_max]   degrees C and %%RH, one decimal\n"
+            "  unit [C|F]\n"
+            "  period <sensor> [ms]                                         0 ms to sample adaptively\n"
+            "  stats\n",
+            name);
+    return 2;
+}
+
+// Purpose: parse a value with one decimal place into tenths
+static int16_t tenths(const char *text) {
+    return (int16_t)lround(strtod(text, nullptr) * 10);
+}
+
+// Purpose: build the command frame from the command line, 0 if it is not understood
+static size_t build(int argc, char **argv, uint16_t tag, uint8_t *buffer, size_t size) {
+    FrameEncoder frame(buffer, size);
+    const char *name = argv[0];
+    if (strcmp(name, "thresholds") == 0 && argc == 1) {
+        frame.put(COMMAND_GET_THRESHOLDS);
+        frame.put_u16(tag);
+    }
+    else if (strcmp(name, "thresholds") == 0 && argc == 5) {
+        frame.put(COMMAND_SET_THRESHOLDS);
+        frame.put_u16(tag);
+        for (int i = 1; i < 5; i++) {
+            frame.put_u16((uint16_t)tenths(argv[i]));
+        }
+    }
+    else if (strcmp(name, "unit") == 0 && argc == 1) {
+        frame.put(COMMAND_GET_UNIT);
+        frame.put_u16(tag);
+    }
+    else if (strcmp(name, "unit") == 0 && argc == 2 && (argv[1][0] == 'C' || argv[1][0] == 'F')) {
+        frame.put(COMMAND_SET_UNIT);
+        frame.put_u16(tag);
+        frame.put(argv[1][0] == 'C' ? 1 : 0);
+    }
+    else if (strcmp(name, "period") == 0 && argc == 2) {
+        frame.put(COMMAND_GET_PERIOD);
+        frame.put_u16(tag);
+        frame.put(atoi(argv[1]));
+    }
+    else if (strcmp(name, "period") == 0 && argc == 3) {
+        frame.put(COMMAND_SET_PERIOD);
+        frame.put_u16(tag);
+        frame.put(atoi(argv[1]));
+        frame.put_u32(strtoul(argv[2], nullptr, 10));
+    }
+    else if (strcmp(name, "stats") == 0 && argc == 1) {
+        frame.put(COMMAND_STATS);
+        frame.put_u16(tag);
+    }
+    else {
+        return 0;
+    }
+    return frame.finish();
+}
+
+// Purpose: print tenths with one decimal place
+static void print_tenths(const char *label, int tenths) {
+    int magnitude = tenths < 0 ? -tenths : tenths;
+    printf("%s%s%d.%d", label, tenths < 0 ? "-" : "", magnitude / 10, magnitude % 10);
+}
+
+// Purpose: print a reply's values
+static void print_reply(const TelemetryRecord &record) {
+    static const char *const errors[] = {"ok", "unknown command", "bad arguments", "out of range", "busy, try again"};
+    if (record.reply.status != COMMAND_OK) {
+        printf("error: %s\n", record.reply.status < 5 ? errors[record.reply.status] : "unknown status");
+        return;
+    }
+    const int32_t *v = record.reply.values;
+    switch (record.reply.command) {
+        case COMMAND_GET_THRESHOLDS:
+            print_tenths("temperature ", v[0]);
+            print_tenths(" to ", v[1]);
+            print_tenths(" C, humidity ", v[2]);
+            print_tenths(" to ", v[3]);
+            printf(" %%RH\n");
+            break;
+        case COMMAND_GET_UNIT:
+            printf("unit %s\n", v[0] ? "Celcius" : "Fahrenheit");
+            break;
+        case COMMAND_GET_PERIOD:
+            printf("read every %ld ms, %s\n", (long)v[0], v[1] ? "fixed" : "adaptive");
+            break;
+        case COMMAND_STATS:
+            printf("uptime %ld s, %ld sensor reads, %ld telemetry records dropped, %ld commands, worst %ld us, "
+                   "heap %ld B\n", (long)v[0], (long)v[1], (long)v[2], (long)v[3], (long)v[4], (long)v[5]);
+            break;
+        default:
+            printf("ok\n");
+            break;
+    }
+}
+
+// Purpose: wait for the reply with the given tag, false on timeout
+static bool wait_reply(int fd, FrameReceiver &receiver, uint8_t *rx, uint16_t tag, TelemetryRecord &record) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(REPLY_TIMEOUT_MS);
+    while (Clock::now() < deadline) {
+        uint8_t byte;
+        if (read(fd, &byte, 1) != 1) {
+            continue;
+        }
+        int length = receiver.put(byte);
+        uint16_t sequence;
+        if (length > 0 && rx[0] == TELEMETRY_REPLY && telemetry_parse(rx, length, sequence, record) &&
+            record.reply.tag == tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        return usage(argv[0]);
+    }
+    int fd = serial_open(argv[1], strtol(argv[2], nullptr, 10));
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    int arg = 3;
+    long repeat = 1;
+    if (strcmp(argv[arg], "-n") == 0 && argc > arg + 2) {
+        repeat = strtol(argv[arg + 1], nullptr, 10);
+        arg += 2;
+    }
+
+    uint8_t rx[MAX_FRAME];
+    FrameReceiver receiver(rx, sizeof(rx));
+    double total_us = 0, best_us = 1e12, worst_us = 0;
+    long answered = 0;
+    TelemetryRecord record;
+    for (long i = 0; i < repeat; i++) {
+        uint8_t tx[MAX_FRAME];
+        uint16_t tag = (uint16_t)i;
+        size_t length = build(argc - arg, argv + arg, tag, tx, sizeof(tx));
+        if (length == 0) {
+            return usage(argv[0]);
+        }
+        Clock::time_point sent = Clock::now();
+        if (write(fd, tx, length) != (ssize_t)length) {
+            perror("write");
+            return 1;
+        }
+        if (!wait_reply(fd, receiver, rx, tag, record)) {
+            fprintf(stderr, "no reply\n");
+            continue;
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - sent).count();
+        total_us += us;
+        best_us = us < best_us ? us : best_us;
+        worst_us = us > worst_us ? us : worst_us;
+        answered++;
+        if (repeat == 1) {
+            print_reply(record);
+            printf("round trip %.0f us, %lu us of it on the device\n", us, (unsigned long)record.reply.latency_us);
+        }
+    }
+    if (repeat > 1 && answered > 0) {
+        print_reply(record);
+        printf("%ld of %ld answered, round trip min %.0f / avg %.0f / max %.0f us\n", answered, repeat, best_us,
+               total_us / answered, worst_us);
+    }
+    return answered == repeat ? 0 : 1;
+}
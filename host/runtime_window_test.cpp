@@ -0,0 +1,185 @@
+// Check the per-thread runtime accounting of diagnostics.cpp
+//
+// Charges samples to made up threads and checks the percentages and the
+// window rollover, then runs a simulated scheduler with known duty cycles
+// under the sampler and checks each thread's measured share against the time
+// it really ran. Prints each failed check and exits non-zero if any failed.
+// Build and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. runtime_window_test.cpp ../runtime_window.cpp -o runtime_window_test
+//   ./runtime_window_test
+
+#include "check.h"
+#include "runtime_window.h"
+#include <cstdio>
+#include <cstdlib>
+
+// made up thread ids, only compared
+static int thread_ids[DIAG_MAX_THREADS + 2];
+#define THREAD(n) ((void *)&thread_ids[n])
+
+// Purpose: permille rounds down, never divides by zero and does not overflow on microsecond uptimes
+static void test_permille() {
+    CHECK(runtime_permille(0, 0) == 0);
+    CHECK(runtime_permille(5, 0) == 0);
+    CHECK(runtime_permille(1, 3) == 333);
+    CHECK(runtime_permille(2, 3) == 666);
+    CHECK(runtime_permille(7, 7) == 1000);
+    uint64_t uptime = 30ULL * 24 * 3600 * 1000000;      // a month in microseconds
+    CHECK(runtime_permille(uptime / 4, uptime) == 250);
+}
+
+// Purpose: samples land on the right thread and the shares add up to the window
+static void test_shares() {
+    RuntimeWindow window;
+    for (int i = 0; i < 700; i++) {
+        window.charge(THREAD(0));
+    }
+    for (int i = 0; i < 250; i++) {
+        window.charge(THREAD(1));
+    }
+    for (int i = 0; i < 50; i++) {
+        window.charge(THREAD(2));
+    }
+    CHECK(window.threads() == 3);
+    CHECK(window.total() == 1000);
+    CHECK(window.unattributed() == 0);
+    CHECK(window.thread(0) == THREAD(0) && window.samples(0) == 700);
+    CHECK(window.thread(1) == THREAD(1) && window.samples(1) == 250);
+    CHECK(window.thread(2) == THREAD(2) && window.samples(2) == 50);
+    CHECK(runtime_permille(window.samples(0), window.total()) == 700);
+    CHECK(runtime_permille(window.samples(2), window.total()) == 50);
+
+    // shares that do not divide evenly are rounded down, so they sum to at most the window and lose under 0.1 % each
+    RuntimeWindow odd;
+    for (int i = 0; i < 7; i++) {
+        odd.charge(THREAD(i % 3));
+    }
+    uint32_t sum = 0;
+    for (size_t i = 0; i < odd.threads(); i++) {
+        sum += runtime_permille(odd.samples(i), odd.total());
+    }
+    CHECK(sum <= 1000 && sum > 1000 - odd.threads());
+}
+
+// Purpose: threads beyond DIAG_MAX_THREADS are counted as unattributed but still part of the window
+static void test_full() {
+    RuntimeWindow window;
+    for (int n = 0; n < DIAG_MAX_THREADS + 2; n++) {
+        window.charge(THREAD(n));
+    }
+    window.charge(THREAD(0));
+    CHECK(window.threads() == DIAG_MAX_THREADS);
+    CHECK(window.unattributed() == 2);
+    CHECK(window.total() == DIAG_MAX_THREADS + 3);
+    CHECK(window.samples(0) == 2);
+}
+
+// Purpose: take() hands over the finished window and starts a new one with the same slots
+static void test_rollover() {
+    RuntimeWindow window;
+    RuntimeWindow finished;
+    for (int i = 0; i < 30; i++) {
+        window.charge(THREAD(i % 2));
+    }
+    window.take(finished);
+    CHECK(finished.total() == 30);
+    CHECK(finished.samples(0) == 15 && finished.samples(1) == 15);
+    CHECK(window.total() == 0);
+    CHECK(window.threads() == 2);
+    CHECK(window.samples(0) == 0 && window.samples(1) == 0);
+
+    // the next window only counts its own samples, a known thread keeps its slot and a new one is added after it
+    window.charge(THREAD(1));
+    window.charge(THREAD(3));
+    window.take(finished);
+    CHECK(finished.total() == 2);
+    CHECK(finished.thread(0) == THREAD(0) && finished.samples(0) == 0);
+    CHECK(finished.thread(1) == THREAD(1) && finished.samples(1) == 1);
+    CHECK(finished.thread(2) == THREAD(3) && finished.samples(2) == 1);
+
+    // an empty window reports nothing rather than dividing by zero
+    window.take(finished);
+    CHECK(finished.total() == 0);
+    CHECK(runtime_permille(finished.samples(0), finished.total()) == 0);
+
+    // unattributed samples are per window too
+    RuntimeWindow full;
+    for (int n = 0; n < DIAG_MAX_THREADS + 1; n++) {
+        full.charge(THREAD(n));
+    }
+    full.take(finished);
+    CHECK(finished.unattributed() == 1);
+    CHECK(full.unattributed() == 0);
+}
+
+// Purpose: sample a simulated scheduler - bursts of random length, each thread running for a known share of the
+// time - at the given rate over windows of the given length, and check the measured shares against the real ones
+static void test_simulated(uint32_t rate_hz, uint32_t window_ms, uint32_t tolerance_permille) {
+    // per-mille of the time each thread runs: three application threads and the idle thread
+    const uint32_t duty[4] = {50, 120, 30, 800};
+    RuntimeWindow window;
+    RuntimeWindow finished;
+    uint64_t ran_us[4] = {0, 0, 0, 0};
+    uint64_t period_us = 1000000 / rate_hz;
+    uint64_t next_sample_us = period_us / 3;    // not aligned with the bursts
+    uint64_t now_us = 0;
+    uint64_t window_end_us = (uint64_t)window_ms * 1000;
+    int windows = 0;
+    srand(1);
+    while (windows < 5) {
+        // pick the next thread in proportion to its duty, and run it for 100 us to 5 ms
+        uint32_t pick = rand() % 1000;
+        int thread = 0;
+        while (pick >= duty[thread]) {
+            pick -= duty[thread];
+            thread++;
+        }
+        uint64_t burst_us = 100 + rand() % 4900;
+        uint64_t end_us = now_us + burst_us;
+        while (next_sample_us < end_us && next_sample_us < window_end_us) {
+            window.charge(THREAD(thread));
+            next_sample_us += period_us;
+        }
+        if (end_us >= window_end_us) {
+            ran_us[thread] += window_end_us - now_us;
+            window.take(finished);
+            for (size_t i = 0; i < finished.threads(); i++) {
+                int n = (int *)finished.thread(i) - thread_ids;
+                uint32_t measured = runtime_permille(finished.samples(i), finished.total());
+                uint32_t real = runtime_permille(ran_us[n], (uint64_t)window_ms * 1000);
+                uint32_t error = measured > real ? measured - real : real - measured;
+                if (error > tolerance_permille) {
+                    printf("FAIL %lu Hz, window %d: thread %d measured %lu permille, ran %lu\n",
+                           (unsigned long)rate_hz, windows, n, (unsigned long)measured, (unsigned long)real);
+                    failed();
+                }
+            }
+            for (uint64_t &ran : ran_us) {
+                ran = 0;
+            }
+            ran_us[thread] = end_us - window_end_us;
+            window_end_us += (uint64_t)window_ms * 1000;
+            windows++;
+            while (next_sample_us < end_us) {       // the rest of the burst is in the new window
+                window.charge(THREAD(thread));
+                next_sample_us += period_us;
+            }
+        }
+        else {
+            ran_us[thread] += burst_us;
+        }
+        now_us = end_us;
+    }
+}
+
+int main() {
+    test_permille();
+    test_shares();
+    test_full();
+    test_rollover();
+    test_simulated(1000, 10000, 10);    // 10000 samples per window: within 1 %
+    test_simulated(100, 10000, 30);     // 1000 samples per window: within 3 %
+    test_simulated(20, 10000, 60);      // the default rate, 200 samples per window: within 6 %
+    return check_summary();
+}
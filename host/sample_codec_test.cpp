@@ -0,0 +1,417 @@
+// Check the delta coded sample batches of sample_codec.cpp
+//
+// Checks the zigzag and varint coding at the edges of their ranges, hand
+// made payloads that are truncated, overlong or name a sensor out of range,
+// and round trips random sample streams - up to SAMPLE_MAX_SENSORS sensors,
+// invalid samples, large jumps, values at the ends of their types - through
+// the encoder, the frame codec and the decoder. Then drops frames from a
+// stream fed to the host TelemetryDecoder and checks that no wrong sample is
+// ever handed on and that each sensor is back within one keyframe interval.
+// Prints each failed check and exits non-zero if any failed, then prints the
+// encode and decode throughput and the bytes per sample for each batch size.
+// Build and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. sample_codec_test.cpp telemetry_decoder.cpp ../frame.cpp ../telemetry_record.cpp ../sample_codec.cpp -o sample_codec_test
+//   ./sample_codec_test
+
+#include "check.h"
+#include "telemetry_decoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define FRAME_BUFFER FRAME_ENCODED_SIZE(TELEMETRY_HEADER_SIZE + SAMPLE_BATCH_MAX * SAMPLE_MAX_ENTRY)
+#define BENCH_SAMPLES 1000000
+
+static std::mt19937 rng(1);
+
+// Purpose: uniform random integer in [low, high]
+static int uniform(int low, int high) {
+    return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+// Purpose: a TELEMETRY_SAMPLE record
+static TelemetryRecord make_sample(uint32_t time_ms, int sensor, bool valid, int celcius, int humidity) {
+    TelemetryRecord record;
+    record.type = TELEMETRY_SAMPLE;
+    record.time_ms = time_ms;
+    record.sample.sensor = sensor;
+    record.sample.valid = valid;
+    record.sample.celcius = valid ? celcius : 0;
+    record.sample.humidity = valid ? humidity : 0;
+    return record;
+}
+
+// Purpose: true if two samples carry the same reading, the values of an invalid one are not compared
+static bool same_sample(const TelemetryRecord &a, const TelemetryRecord &b) {
+    return a.type == b.type && a.time_ms == b.time_ms && a.sample.sensor == b.sample.sensor &&
+           a.sample.valid == b.sample.valid &&
+           (!a.sample.valid || (a.sample.celcius == b.sample.celcius && a.sample.humidity == b.sample.humidity));
+}
+
+// Purpose: encode samples as one batch, returns the framed bytes without the delimiter
+static std::vector<uint8_t> encode_batch(SampleEncoder &encoder, uint16_t sequence, const TelemetryRecord *samples,
+                                         size_t count) {
+    uint8_t tx[FRAME_BUFFER];
+    FrameEncoder frame(tx, sizeof(tx));
+    encoder.begin(sequence, samples[0].time_ms, frame);
+    for (size_t i = 0; i < count; i++) {
+        encoder.add(samples[i], frame);
+    }
+    size_t length = frame.finish();
+    CHECK(length > 0);
+    return std::vector<uint8_t>(tx, tx + (length ? length - 1 : 0));
+}
+
+// Purpose: encode one batch and decode it again, returns the payload length or -1
+static int round_trip(SampleEncoder &encoder, SampleDecoder &decoder, const TelemetryRecord *samples, size_t count,
+                      TelemetryRecord *decoded, int &decoded_count) {
+    std::vector<uint8_t> frame = encode_batch(encoder, 7, samples, count);
+    int payload = frame_decode(frame.data(), frame.size());
+    uint16_t sequence = 0;
+    decoded_count = payload < 0 ? -1 : decoder.parse(frame.data(), payload, sequence, decoded, SAMPLE_BATCH_MAX);
+    CHECK(sequence == 7);
+    return payload;
+}
+
+// Purpose: parse a hand made payload with a fresh decoder
+static int parse_bytes(std::vector<uint8_t> entries, size_t max = SAMPLE_BATCH_MAX) {
+    std::vector<uint8_t> payload = {TELEMETRY_SAMPLES, 1, 0, 100, 0, 0, 0};
+    payload.insert(payload.end(), entries.begin(), entries.end());
+    SampleDecoder decoder;
+    TelemetryRecord samples[SAMPLE_BATCH_MAX + 1];
+    uint16_t sequence;
+    return decoder.parse(payload.data(), payload.size(), sequence, samples, max);
+}
+
+// Purpose: zigzag keeps small magnitudes small, covers the whole int32 range and undoes itself
+static void test_zigzag() {
+    CHECK(zigzag_encode(0) == 0);
+    CHECK(zigzag_encode(-1) == 1);
+    CHECK(zigzag_encode(1) == 2);
+    CHECK(zigzag_encode(63) == 126);
+    CHECK(zigzag_encode(-64) == 127);
+    CHECK(zigzag_encode(64) == 128);
+    CHECK(zigzag_encode(INT32_MAX) == 0xFFFFFFFE);
+    CHECK(zigzag_encode(INT32_MIN) == 0xFFFFFFFF);
+    const int32_t edges[] = {0, 1, -1, 63, -64, 64, -65, 8191, -8192, 8192, INT16_MAX, INT16_MIN, INT32_MAX,
+                             INT32_MIN};
+    for (int32_t value : edges) {
+        CHECK(zigzag_decode(zigzag_encode(value)) == value);
+    }
+    for (int i = 0; i < 100000; i++) {
+        int32_t value = (int32_t)rng();
+        CHECK(zigzag_decode(zigzag_encode(value)) == value);
+    }
+}
+
+// Purpose: a varint takes one byte per 7 bits of the zigzag coded value, up to 5, and the largest entry fits
+// SAMPLE_MAX_ENTRY
+static void test_varint_lengths() {
+    struct {
+        int32_t dt;
+        size_t bytes;
+    } lengths[] = {{0, 1}, {63, 1}, {-64, 1}, {64, 2}, {-65, 2}, {8191, 2}, {-8192, 2}, {8192, 3}, {1048575, 3},
+                   {1048576, 4}, {134217727, 4}, {134217728, 5}, {INT32_MAX, 5}, {INT32_MIN, 5}};
+    for (auto &length : lengths) {
+        // an invalid sample is its flags and dt alone
+        SampleEncoder encoder;
+        SampleDecoder decoder;
+        TelemetryRecord samples[2] = {make_sample(1000, 0, false, 0, 0),
+                                      make_sample(1000 + (uint32_t)length.dt, 0, false, 0, 0)};
+        TelemetryRecord decoded[SAMPLE_BATCH_MAX];
+        int count;
+        int payload = round_trip(encoder, decoder, samples, 2, decoded, count);
+        CHECK(payload == (int)(TELEMETRY_HEADER_SIZE + 2 + 1 + length.bytes));
+        CHECK(count == 2 && same_sample(decoded[1], samples[1]));
+    }
+
+    // keyframe at the ends of both value types, the delta to the other end, and the longest dt
+    SampleEncoder encoder;
+    SampleDecoder decoder;
+    TelemetryRecord samples[3] = {make_sample(0, 5, true, INT16_MIN, UINT16_MAX),
+                                  make_sample(0x80000000, 5, true, INT16_MAX, 0),
+                                  make_sample(0x80000000, 5, true, INT16_MIN, UINT16_MAX)};
+    TelemetryRecord decoded[SAMPLE_BATCH_MAX];
+    int count;
+    int payload = round_trip(encoder, decoder, samples, 1, decoded, count);
+    CHECK(payload == TELEMETRY_HEADER_SIZE + 1 + 1 + 3 + 3);
+    CHECK(count == 1 && same_sample(decoded[0], samples[0]));
+    TelemetryRecord first = make_sample(0, 5, false, 0, 0);
+    TelemetryRecord batch[3] = {first, samples[1], samples[2]};
+    payload = round_trip(encoder, decoder, batch, 3, decoded, count);
+    CHECK(payload <= (int)(TELEMETRY_HEADER_SIZE + 3 * SAMPLE_MAX_ENTRY));
+    CHECK(payload == TELEMETRY_HEADER_SIZE + 2 + (1 + 5 + 3 + 3) + (1 + 1 + 3 + 3));
+    CHECK(count == 3 && same_sample(decoded[1], samples[1]) && same_sample(decoded[2], samples[2]));
+}
+
+// Purpose: truncated, overlong and out of range payloads are refused rather than read past or misread
+static void test_malformed() {
+    CHECK(parse_bytes({}) == 0);
+    CHECK(parse_bytes({0x40, 0x00}) == 1);                             // invalid sample, dt 0
+    CHECK(parse_bytes({0x40, 0x80, 0x00}) == 1);                       // a non-minimal varint is still a value
+    CHECK(parse_bytes({0x40, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F}) == 1);     // 32 bits exactly
+    CHECK(parse_bytes({0x40}) == -1);                                  // flags without dt
+    CHECK(parse_bytes({0x40, 0x80}) == -1);                            // dt truncated
+    CHECK(parse_bytes({0x40, 0xFF, 0xFF, 0xFF, 0xFF, 0x10}) == -1);    // over 32 bits
+    CHECK(parse_bytes({0x40, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00}) == -1);      // over 5 bytes
+    CHECK(parse_bytes({0x80, 0x00, 0x02}) == -1);                      // keyframe without humidity
+    CHECK(parse_bytes({0x80, 0x00, 0x02, 0x80}) == -1);                // humidity truncated
+    CHECK(parse_bytes({0x80, 0x00, 0x02, 0x04}) == 1);
+    CHECK(parse_bytes({0x40 | SAMPLE_MAX_SENSORS, 0x00}) == -1);       // sensor out of range
+    CHECK(parse_bytes({0x40 | SAMPLE_SENSOR_MASK, 0x00}) == -1);
+
+    std::vector<uint8_t> full;
+    for (int i = 0; i < SAMPLE_BATCH_MAX; i++) {
+        full.insert(full.end(), {0x40, 0x00});
+    }
+    CHECK(parse_bytes(full) == SAMPLE_BATCH_MAX);
+    CHECK(parse_bytes(full, SAMPLE_BATCH_MAX - 1) == -1);              // more samples than room
+
+    SampleDecoder decoder;
+    TelemetryRecord samples[SAMPLE_BATCH_MAX];
+    uint16_t sequence;
+    uint8_t short_header[] = {TELEMETRY_SAMPLES, 1, 0, 0, 0, 0};
+    CHECK(decoder.parse(short_header, sizeof(short_header), sequence, samples, SAMPLE_BATCH_MAX) == -1);
+    uint8_t other_type[] = {TELEMETRY_SAMPLE, 1, 0, 0, 0, 0, 0};
+    CHECK(decoder.parse(other_type, sizeof(other_type), sequence, samples, SAMPLE_BATCH_MAX) == -1);
+}
+
+// a random stream of samples from several sensors, each a random walk with the odd jump
+class SampleStream {
+public:
+    explicit SampleStream(int sensors) : _sensors(sensors), _time(uniform(0, 1 << 30)) {
+        for (int i = 0; i < sensors; i++) {
+            _celcius[i] = uniform(-400, 800);
+            _humidity[i] = uniform(0, 1000);
+        }
+    }
+
+    // Purpose: the next sample, times never go backwards
+    TelemetryRecord next(bool strictly_later) {
+        int sensor = uniform(0, _sensors - 1);
+        int kind = uniform(0, 99);
+        if (kind < 3) {
+            _time += uniform(100000, 2000000000);     // a long pause, or time wrapping past 2^32
+        }
+        else {
+            _time += uniform(strictly_later ? 1 : 0, 3000);
+        }
+        if (kind < 10) {
+            return make_sample(_time, sensor, false, 0, 0);
+        }
+        if (kind < 13) {
+            _celcius[sensor] = uniform(0, 1) ? INT16_MIN : INT16_MAX;
+            _humidity[sensor] = uniform(0, 1) ? 0 : UINT16_MAX;
+        }
+        else if (kind < 20) {
+            _celcius[sensor] = uniform(-400, 800);
+            _humidity[sensor] = uniform(0, 1000);
+        }
+        else {
+            _celcius[sensor] = clamp(_celcius[sensor] + uniform(-3, 3), INT16_MIN, INT16_MAX);
+            _humidity[sensor] = clamp(_humidity[sensor] + uniform(-5, 5), 0, UINT16_MAX);
+        }
+        return make_sample(_time, sensor, true, _celcius[sensor], _humidity[sensor]);
+    }
+
+private:
+    static int clamp(int value, int low, int high) {
+        return value < low ? low : value > high ? high : value;
+    }
+
+    int _sensors;
+    uint32_t _time;
+    int _celcius[SAMPLE_MAX_SENSORS];
+    int _humidity[SAMPLE_MAX_SENSORS];
+};
+
+// Purpose: every sample of a random stream comes back exactly, in random batch sizes, for 1 to SAMPLE_MAX_SENSORS
+// sensors
+static void test_round_trip() {
+    for (int sensors = 1; sensors <= SAMPLE_MAX_SENSORS; sensors++) {
+        for (int run = 0; run < 20; run++) {
+            SampleStream stream(sensors);
+            SampleEncoder encoder;
+            SampleDecoder decoder;
+            int wrong = 0;
+            for (int batch = 0; batch < 200; batch++) {
+                TelemetryRecord samples[SAMPLE_BATCH_MAX];
+                int count = uniform(1, SAMPLE_BATCH_MAX);
+                for (int i = 0; i < count; i++) {
+                    samples[i] = stream.next(false);
+                }
+                TelemetryRecord decoded[SAMPLE_BATCH_MAX];
+                int decoded_count;
+                int payload = round_trip(encoder, decoder, samples, count, decoded, decoded_count);
+                CHECK(payload > 0 && payload <= TELEMETRY_HEADER_SIZE + count * SAMPLE_MAX_ENTRY);
+                if (decoded_count != count) {
+                    wrong++;
+                    continue;
+                }
+                for (int i = 0; i < count; i++) {
+                    wrong += !same_sample(decoded[i], samples[i]);
+                }
+            }
+            CHECK(wrong == 0);
+            CHECK(decoder.unsynced() == 0);
+        }
+    }
+}
+
+// Purpose: frames dropped from a stream fed to the host decoder never give a wrong sample, every sample arrives
+// unless its sensor waits for a keyframe, and that wait is at most SAMPLE_KEYFRAME_INTERVAL of its samples
+static void test_resync() {
+    bool stale_without_reset = false;
+    for (int run = 0; run < 200; run++) {
+        int sensors = uniform(1, SAMPLE_MAX_SENSORS);
+        SampleStream stream(sensors);
+        SampleEncoder encoder;
+        std::vector<TelemetryRecord> sent;
+        std::vector<std::vector<uint8_t>> frames;
+        std::vector<size_t> first;      // index in sent of each frame's first sample
+        for (uint16_t sequence = 0; sequence < 300; sequence++) {
+            TelemetryRecord samples[SAMPLE_BATCH_MAX];
+            int count = uniform(1, SAMPLE_BATCH_MAX);
+            for (int i = 0; i < count; i++) {
+                samples[i] = stream.next(true);
+            }
+            first.push_back(sent.size());
+            sent.insert(sent.end(), samples, samples + count);
+            frames.push_back(encode_batch(encoder, sequence, samples, count));
+        }
+        first.push_back(sent.size());
+
+        // drop a few frames, or start listening mid-stream
+        std::vector<bool> dropped(frames.size(), false);
+        size_t start = run % 4 == 0 ? uniform(1, 50) : 0;
+        for (int i = uniform(1, 4); i > 0; i--) {
+            dropped[uniform(start + 1, frames.size() - 20)] = true;
+        }
+
+        std::vector<TelemetryRecord> received;
+        TelemetryDecoder decoder([&received](const TelemetryRecord &record, uint16_t) { received.push_back(record); });
+        SampleDecoder unreset;          // the same frames without the reset after a gap
+        for (size_t i = start; i < frames.size(); i++) {
+            if (dropped[i]) {
+                continue;
+            }
+            std::vector<uint8_t> bytes = frames[i];
+            bytes.push_back(0);
+            decoder.feed(bytes.data(), bytes.size());
+
+            bytes.pop_back();
+            int payload = frame_decode(bytes.data(), bytes.size());
+            TelemetryRecord decoded[SAMPLE_BATCH_MAX];
+            uint16_t sequence;
+            int count = unreset.parse(bytes.data(), payload, sequence, decoded, SAMPLE_BATCH_MAX);
+            for (int j = 0, k = first[i]; j < count; j++, k++) {
+                while (k < (int)first[i + 1] && sent[k].time_ms != decoded[j].time_ms) k++;
+                stale_without_reset |= k < (int)first[i + 1] && !same_sample(decoded[j], sent[k]);
+            }
+        }
+
+        // walk the sent samples of the frames that arrived, matching each received one by its time
+        size_t next = 0;
+        int wrong = 0;
+        int waiting[SAMPLE_MAX_SENSORS] = {};       // samples of each sensor missed since it was last decoded
+        bool synced[SAMPLE_MAX_SENSORS] = {};
+        for (size_t i = start; i < frames.size(); i++) {
+            if (dropped[i]) {
+                for (int sensor = 0; sensor < SAMPLE_MAX_SENSORS; sensor++) {
+                    synced[sensor] = false;
+                    waiting[sensor] = 0;
+                }
+                continue;
+            }
+            for (size_t k = first[i]; k < first[i + 1]; k++) {
+                const TelemetryRecord &expected = sent[k];
+                int sensor = expected.sample.sensor;
+                if (next < received.size() && received[next].time_ms == expected.time_ms) {
+                    wrong += !same_sample(received[next++], expected);
+                    if (expected.sample.valid) {
+                        synced[sensor] = true;
+                        waiting[sensor] = 0;
+                    }
+                }
+                else {
+                    wrong += !expected.sample.valid || synced[sensor];      // only a delta may be held back
+                    CHECK(++waiting[sensor] <= SAMPLE_KEYFRAME_INTERVAL);
+                }
+            }
+        }
+        CHECK(next == received.size());
+        CHECK(wrong == 0);
+        CHECK(decoder.lost() == (unsigned long)std::count(dropped.begin() + start, dropped.end(), true));
+    }
+    CHECK(stale_without_reset);     // the reset is what keeps the stale deltas out
+}
+
+// Purpose: time encoding and decoding BENCH_SAMPLES samples from two sensors in batches of the given size
+static void bench(int batch) {
+    SampleStream stream(2);
+    std::vector<TelemetryRecord> samples;
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        TelemetryRecord sample = stream.next(true);
+        samples.push_back(make_sample(sample.time_ms, sample.sample.sensor, true,
+                                      20 * (sample.sample.sensor + 10) + uniform(-2, 2), 450 + uniform(-3, 3)));
+    }
+
+    std::vector<uint8_t> stream_bytes;
+    stream_bytes.reserve((size_t)BENCH_SAMPLES * FRAME_BUFFER / batch);
+    std::vector<size_t> ends;
+    SampleEncoder encoder;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < samples.size(); i += batch) {
+        uint8_t tx[FRAME_BUFFER];
+        FrameEncoder frame(tx, sizeof(tx));
+        encoder.begin((uint16_t)i, samples[i].time_ms, frame);
+        for (size_t j = i; j < i + batch && j < samples.size(); j++) {
+            encoder.add(samples[j], frame);
+        }
+        size_t length = frame.finish();
+        stream_bytes.insert(stream_bytes.end(), tx, tx + length - 1);
+        ends.push_back(stream_bytes.size());
+    }
+    double encode_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    SampleDecoder decoder;
+    unsigned long decoded = 0;
+    start = std::chrono::steady_clock::now();
+    size_t begin = 0;
+    for (size_t end : ends) {
+        int payload = frame_decode(stream_bytes.data() + begin, end - begin);
+        TelemetryRecord records[SAMPLE_BATCH_MAX];
+        uint16_t sequence;
+        int count = decoder.parse(stream_bytes.data() + begin, payload, sequence, records, SAMPLE_BATCH_MAX);
+        decoded += count > 0 ? count : 0;
+        begin = end;
+    }
+    double decode_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(decoded == samples.size());
+
+    printf("%5d  %7.2f  %9.0f  %9.0f\n", batch, (double)(stream_bytes.size() + ends.size()) / samples.size(),
+           samples.size() / encode_s / 1000, decoded / decode_s / 1000);
+}
+
+int main() {
+    test_zigzag();
+    test_varint_lengths();
+    test_malformed();
+    test_round_trip();
+    test_resync();
+
+    uint8_t tx[FRAME_ENCODED_SIZE(TELEMETRY_MAX_PAYLOAD)];
+    FrameEncoder frame(tx, sizeof(tx));
+    telemetry_encode(make_sample(0, 0, true, 215, 450), 0, frame);
+    printf("one TELEMETRY_SAMPLE record: %lu bytes framed\n", (unsigned long)frame.finish());
+    printf("batch  B/sample  encode k/s  decode k/s\n");
+    for (int batch = 1; batch <= SAMPLE_BATCH_MAX; batch *= 2) {
+        bench(batch);
+    }
+
+    return check_summary();
+}
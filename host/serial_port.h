@@ -0,0 +1,15 @@
+// POSIX serial port setup shared by the host tools
+
+#ifndef HOST_SERIAL_PORT_H
+#define HOST_SERIAL_PORT_H
+
+/** Open a serial port raw, 8N1, reads returning whatever arrived within 100 ms.
+ *
+ * @param path device, e.g. /dev/ttyACM0
+ * @param baud baud rate, one of the standard rates from 9600 up
+ * @returns
+ *   file descriptor, or -1 with errno set (EINVAL for a baud rate termios has no constant for)
+ */
+int serial_open(const char *path, long baud);
+
+#endif
@@ -0,0 +1,147 @@
+// Check what the diagnostics sampler does to the stop mode residency it reports
+//
+// Lays out a minute of the firmware's wake-ups - the sensor slots, the heap
+// check, the diagnostics report and the sampler ticks - and sleeps the
+// idle gaps the way the tickless idle thread does: a gap shorter than the
+// deep sleep latency is slept in sleep mode, a longer one in stop mode less
+// the time it takes to wake up from it. The periods and the sampler rate are
+// read from ../mbed_app.json, heap_guard.h and the sensor array in the main
+// file, so the check follows the configuration it is built against. Prints
+// the stop residency with the sampler at each rate against the same minute
+// without it, and fails if the sampler at diag-sample-rate-hz takes more than
+// RESIDENCY_TOLERANCE off the figure, or if the model does not show the
+// effect at 1000 Hz. Build and run from this directory:
+//
+//   g++ -std=c++14 -O2 sleep_residency_test.cpp app_config.cpp -o sleep_residency_test
+//   ./sleep_residency_test
+
+#include "app_config.h"
+#include "check.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#define MAIN_PATH "../CSE321_project3_brettsit_main.cpp"
+#define HEAP_GUARD_PATH "../heap_guard.h"
+#define RESIDENCY_TOLERANCE 10          // permille of stop residency the sampler may take at diag-sample-rate-hz
+#define DEEP_SLEEP_LATENCY_US 3000      // target.deep-sleep-latency, shorter idle gaps are slept in sleep mode
+#define WAKE_US 150                     // leaving stop mode until the clocks are restored (PLL relock)
+#define SAMPLE_US 10                    // sampler ISR, in and out of the RTOS
+#define RUN_S 60
+
+// a stretch of time the core runs
+struct Busy {
+    uint64_t start_us;
+    uint64_t length_us;
+};
+
+// Purpose: add a wake-up every period_us running length_us, starting at offset_us
+static void add_periodic(std::vector<Busy> &busy, uint64_t period_us, uint64_t offset_us, uint64_t length_us) {
+    for (uint64_t t = offset_us; t < (uint64_t)RUN_S * 1000000; t += period_us) {
+        busy.push_back({t, length_us});
+    }
+}
+
+// the firmware's settings the wake-ups follow
+struct Schedule {
+    uint32_t sample_rate_hz;        // diag-sample-rate-hz
+    uint32_t report_ms;             // diag-report-period-ms
+    uint32_t sensor_interval_ms;    // sensor-interval-ms
+    uint32_t heap_check_ms;         // HEAP_GUARD_CHECK_PERIOD
+    uint32_t sensors;               // channels of the SensorArray, one slot each per sensor interval
+};
+
+// Purpose: count the drivers of the SensorArray declared in the main file
+static bool sensor_count(const std::string &source, uint32_t &count) {
+    size_t at = source.find("\nSensorArray<");
+    size_t end = at == std::string::npos ? at : source.find('>', at);
+    if (end == std::string::npos) {
+        printf("no SensorArray in %s\n", MAIN_PATH);
+        return false;
+    }
+    count = 1 + std::count(source.begin() + at, source.begin() + end, ',');
+    return true;
+}
+
+// Purpose: read the schedule from the firmware's sources, false if any of it is missing
+static bool load_schedule(Schedule &schedule) {
+    std::string json;
+    std::string heap_guard;
+    std::string main_file;
+    return read_file(APP_CONFIG_PATH, json) && read_file(HEAP_GUARD_PATH, heap_guard) &&
+           read_file(MAIN_PATH, main_file) && config_value(json, "diag-sample-rate-hz", schedule.sample_rate_hz) &&
+           config_value(json, "diag-report-period-ms", schedule.report_ms) &&
+           config_value(json, "sensor-interval-ms", schedule.sensor_interval_ms) &&
+           define_value(heap_guard, "HEAP_GUARD_CHECK_PERIOD", schedule.heap_check_ms) &&
+           sensor_count(main_file, schedule.sensors);
+}
+
+// Purpose: the firmware's own wake-ups
+static std::vector<Busy> application(const Schedule &schedule) {
+    std::vector<Busy> busy;
+    // sensor slot: the ~4 ms frame, decode, publish, LCD refresh; every slot reads, as before any adaptive stretch
+    add_periodic(busy, (uint64_t)schedule.sensor_interval_ms * 1000 / schedule.sensors, 0, 9000);
+    add_periodic(busy, (uint64_t)schedule.heap_check_ms * 1000, 500000, 50);       // heap guard check
+    add_periodic(busy, (uint64_t)schedule.report_ms * 1000, 5000000, 20000);        // diagnostics report over serial
+    return busy;
+}
+
+// Purpose: permille of the run spent in stop mode
+static uint32_t stop_permille(std::vector<Busy> busy) {
+    std::sort(busy.begin(), busy.end(), [](const Busy &a, const Busy &b) { return a.start_us < b.start_us; });
+    busy.push_back({(uint64_t)RUN_S * 1000000, 0});     // the end of the run closes the last gap
+    uint64_t stop_us = 0;
+    uint64_t free_at = 0;
+    for (const Busy &b : busy) {
+        if (b.start_us > free_at) {
+            uint64_t gap = b.start_us - free_at;
+            if (gap >= DEEP_SLEEP_LATENCY_US) {
+                stop_us += gap - WAKE_US;
+            }
+        }
+        free_at = std::max(free_at, b.start_us) + b.length_us;
+    }
+    return (uint32_t)(stop_us * 1000 / ((uint64_t)RUN_S * 1000000));
+}
+
+int main() {
+    Schedule schedule;
+    if (!load_schedule(schedule) || schedule.sample_rate_hz == 0 || schedule.sensors == 0) {
+        printf("FAIL could not read the schedule\n");
+        return 1;
+    }
+    std::vector<uint32_t> rates = {1000, 500, 200, 100, 50, 20, 10};
+    if (std::find(rates.begin(), rates.end(), schedule.sample_rate_hz) == rates.end()) {
+        rates.push_back(schedule.sample_rate_hz);
+        std::sort(rates.rbegin(), rates.rend());
+    }
+    printf("%lu sensor slot(s) per %lu ms, heap check every %lu ms, report every %lu ms\n",
+           (unsigned long)schedule.sensors, (unsigned long)schedule.sensor_interval_ms,
+           (unsigned long)schedule.heap_check_ms, (unsigned long)schedule.report_ms);
+
+    uint32_t undiagnosed = stop_permille(application(schedule));
+    printf("without the sampler: %lu.%lu %% in stop mode\n", (unsigned long)(undiagnosed / 10),
+           (unsigned long)(undiagnosed % 10));
+    printf("sampler Hz   stop %%   taken off\n");
+    for (uint32_t rate : rates) {
+        std::vector<Busy> busy = application(schedule);
+        add_periodic(busy, 1000000 / rate, 333, SAMPLE_US);     // its own low power ticker, not aligned with the rest
+        uint32_t stop = stop_permille(busy);
+        uint32_t taken = undiagnosed - stop;
+        bool configured = rate == schedule.sample_rate_hz;
+        printf("%10lu  %4lu.%lu    %4lu.%lu%s\n", (unsigned long)rate, (unsigned long)(stop / 10),
+               (unsigned long)(stop % 10), (unsigned long)(taken / 10), (unsigned long)(taken % 10),
+               configured ? "   <- diag-sample-rate-hz" : "");
+        if (configured && taken > RESIDENCY_TOLERANCE) {
+            printf("FAIL the sampler at %lu Hz takes %lu permille off the stop residency\n",
+                   (unsigned long)rate, (unsigned long)taken);
+            failed();
+        }
+        if (rate == 1000 && taken <= RESIDENCY_TOLERANCE) {
+            printf("FAIL the model shows no cost for a 1000 Hz sampler\n");
+            failed();
+        }
+    }
+    return check_summary();
+}
@@ -0,0 +1,217 @@
+// Stress test the lock-free snapshots of the state store
+//
+// First replays the interleaving that tears a copy when only the version is
+// checked around it: a reader is held mid-copy while one write completes and
+// a second one is held halfway through refilling the reader's slot. The
+// reader must come back with a complete value without waiting for the held
+// writer.
+//
+// Then writer threads publish values whose fields are all derived from one
+// counter while reader threads copy them out as fast as they can; a copy
+// whose fields do not agree was torn by a write. A run with a single writer
+// checks that the version returned with a copy is the one it was published
+// under, and that no reader ever sees the version go backwards. Prints each
+// failure and exits non-zero if any. Build it with ThreadSanitizer too, which
+// reports any plain data race between the copy and a write. Build and run
+// from this directory:
+//
+//   g++ -std=c++14 -O2 -pthread -I.. snapshot_test.cpp -o snapshot_test
+//   g++ -std=c++14 -O1 -g -fsanitize=thread -Wno-tsan -pthread -I.. snapshot_test.cpp -o snapshot_test_tsan
+//   ./snapshot_test && ./snapshot_test_tsan
+
+#include "check.h"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// hold points for the replayed interleaving, armed by test_interleaving()
+static std::atomic<bool> hold_reader(false);    // hold the next copy before its second word
+static std::atomic<bool> reader_held(false);
+static std::atomic<bool> release_reader(false);
+static std::atomic<bool> hold_writer(false);    // hold the next write after its second word
+static std::atomic<bool> writer_held(false);
+static std::atomic<bool> release_writer(false);
+
+// Purpose: stop at a hold point until the test releases it
+static void hold(size_t word, std::atomic<bool> &armed, std::atomic<bool> &held, std::atomic<bool> &release) {
+    bool expected = true;
+    if (word == 1 && armed.compare_exchange_strong(expected, false)) {
+        held = true;
+        while (!release) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+#define SNAPSHOT_LOAD_HOOK(word) hold((word), hold_reader, reader_held, release_reader)
+#define SNAPSHOT_STORE_HOOK(word) hold((word), hold_writer, writer_held, release_writer)
+#include "snapshot.h"
+
+#define WRITES 200000           // values published by each writer
+#define READERS 4
+#define FIELDS 64               // larger than the state store's values, so a copy takes long enough to be preempted
+
+// every field follows from key
+struct Value {
+    int32_t key;
+    int32_t fields[FIELDS];
+};
+
+// Purpose: the value published for key
+static Value make(int32_t key) {
+    Value value;
+    value.key = key;
+    for (int i = 0; i < FIELDS; i++) {
+        value.fields[i] = key * (i + 1) ^ i;
+    }
+    return value;
+}
+
+// Purpose: false if the fields of a copy came from different writes
+static bool consistent(const Value &value) {
+    for (int i = 0; i < FIELDS; i++) {
+        if (value.fields[i] != (value.key * (i + 1) ^ i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Purpose: wait for a thread to reach its hold point
+static void wait_held(std::atomic<bool> &held) {
+    while (!held) {
+        std::this_thread::yield();
+    }
+}
+
+// Purpose: replay a reader held mid-copy of the current slot while one write completes into the other slot and
+// the next starts refilling the reader's slot and is held halfway
+static void test_interleaving() {
+    Snapshot<Value, std::mutex> snapshot(make(0));
+    snapshot.write(make(1));                    // version 1, in slot 1
+
+    Value copy;
+    uint32_t version = 0;
+    hold_reader = true;
+    std::thread reader([&] {
+        copy = snapshot.read(&version);         // held after the first word of slot 1
+    });
+    wait_held(reader_held);
+
+    snapshot.write(make(2));                    // version 2, in slot 0
+    hold_writer = true;
+    std::thread writer([&] {
+        snapshot.write(make(3));                // refills slot 1, held after its second word
+    });
+    wait_held(writer_held);
+
+    release_reader = true;
+    reader.join();                              // must not wait for the held writer
+    bool ok = consistent(copy) && copy.key == 2 && version == 2;
+    printf("interleaving: read key %ld version %lu, %s\n", (long)copy.key, (unsigned long)version,
+           ok ? "complete" : "TORN");
+    if (!ok) {
+        failed();
+    }
+
+    release_writer = true;
+    writer.join();
+    copy = snapshot.read(&version);
+    if (!consistent(copy) || copy.key != 3 || version != 3) {
+        printf("FAIL the held write did not complete\n");
+        failed();
+    }
+}
+
+// Purpose: several writers against several readers, count the torn copies
+static void test_torn(int writers) {
+    Snapshot<Value, std::mutex> snapshot(make(0));
+    std::atomic<int> writing(writers);
+    std::atomic<unsigned long> torn(0);
+    std::atomic<unsigned long> reads(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < READERS; r++) {
+        threads.emplace_back([&] {
+            unsigned long count = 0;
+            while (writing > 0) {
+                if (!consistent(snapshot.read())) {
+                    torn++;
+                }
+                count++;
+            }
+            reads += count;
+        });
+    }
+    for (int w = 0; w < writers; w++) {
+        threads.emplace_back([&, w] {
+            for (int32_t i = 1; i <= WRITES; i++) {
+                snapshot.write(make(i * writers + w));
+            }
+            writing--;
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    printf("%d writers: %lu reads, %lu torn\n", writers, (unsigned long)reads, (unsigned long)torn);
+    if (torn != 0) {
+        failed();
+    }
+    if (snapshot.version() != (uint32_t)(WRITES * writers)) {
+        printf("FAIL version %lu after %d writes\n", (unsigned long)snapshot.version(), WRITES * writers);
+        failed();
+    }
+}
+
+// Purpose: with one writer, write k is published as version k - the version returned with a copy must be the
+// copy's own, and each reader must see versions in order
+static void test_versions() {
+    Snapshot<Value, std::mutex> snapshot(make(0));
+    std::atomic<bool> writing(true);
+    std::atomic<unsigned long> wrong(0);
+    std::atomic<unsigned long> backwards(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < READERS; r++) {
+        threads.emplace_back([&] {
+            uint32_t last = 0;
+            while (writing) {
+                uint32_t version;
+                Value value = snapshot.read(&version);
+                if ((uint32_t)value.key != version || !consistent(value)) {
+                    wrong++;
+                }
+                if (version < last) {
+                    backwards++;
+                }
+                last = version;
+            }
+        });
+    }
+    for (int32_t i = 1; i <= WRITES; i++) {
+        snapshot.write(make(i));
+    }
+    writing = false;
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    printf("versions: %lu copies with the wrong version, %lu went backwards\n", (unsigned long)wrong,
+           (unsigned long)backwards);
+    if (wrong != 0 || backwards != 0) {
+        failed();
+    }
+}
+
+int main() {
+    test_interleaving();
+    test_torn(1);
+    test_torn(2);
+    test_torn(3);
+    test_versions();
+    return check_summary();
+}
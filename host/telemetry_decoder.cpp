@@ -0,0 +1,57 @@
+// Host side decoder for the climate monitor's telemetry stream
+
+#include "telemetry_decoder.h"
+
+TelemetryDecoder::TelemetryDecoder(Handler handler)
+    : _handler(handler), _receiver(_frame, sizeof(_frame)), _synced(false), _next_sequence(0), _records(0),
+      _bad_frames(0), _unknown(0), _lost(0) {
+}
+
+void TelemetryDecoder::feed(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        int payload = _receiver.put(data[i]);
+        if (payload == -1) {
+            _bad_frames++;
+        }
+        else if (payload != FRAME_PENDING) {
+            frame_done(payload);
+        }
+    }
+}
+
+void TelemetryDecoder::frame_done(size_t payload) {
+    if (payload < TELEMETRY_HEADER_SIZE) {
+        _unknown++;
+        return;
+    }
+    uint16_t sequence = frame_get_u16(_frame + 1);
+    uint16_t gap = sequence - _next_sequence;
+    if (!_synced || gap != 0) {
+        _samples.reset();               // a missed frame may have held the base of the next deltas
+    }
+    if (_synced && gap < 0x8000) {     // a jump backwards is the device restarting, not a loss
+        _lost += gap;
+    }
+    _synced = true;
+    _next_sequence = sequence + 1;
+    if (_frame[0] == TELEMETRY_HISTORY) {
+        return;                         // answers to a history dump, see history_dump.cpp
+    }
+
+    TelemetryRecord records[SAMPLE_BATCH_MAX];
+    int count;
+    if (_frame[0] == TELEMETRY_SAMPLES) {
+        count = _samples.parse(_frame, payload, sequence, records, SAMPLE_BATCH_MAX);
+    }
+    else {
+        count = telemetry_parse(_frame, payload, sequence, records[0]) ? 1 : -1;
+    }
+    if (count < 0) {
+        _unknown++;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        _records++;
+        _handler(records[i], sequence);
+    }
+}
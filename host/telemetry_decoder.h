@@ -0,0 +1,75 @@
+// Host side decoder for the climate monitor's telemetry stream
+//
+// Feed it the bytes read from the serial port in whatever chunks they
+// arrive; it splits them into frames at each zero byte, checks and unstuffs
+// them with the firmware's own frame.cpp and parses the records with its
+// telemetry_record.cpp and sample_codec.cpp, handing each sample of a batch
+// on as its own TELEMETRY_SAMPLE record. Damaged frames and sequence gaps
+// are counted.
+//
+// Not part of the firmware: host/.mbedignore keeps it out of the mbed build.
+
+#ifndef HOST_TELEMETRY_DECODER_H
+#define HOST_TELEMETRY_DECODER_H
+
+#include "sample_codec.h"
+#include <functional>
+
+#define DECODER_MAX_FRAME 512       // longer runs without a delimiter are discarded
+
+/** Streaming telemetry decoder.
+ *
+ * Example:
+ * @code
+ * TelemetryDecoder decoder([](const TelemetryRecord &record, uint16_t sequence) {
+ *     if (record.type == TELEMETRY_SAMPLE) { ... }
+ * });
+ * while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+ *     decoder.feed(buffer, n);
+ * }
+ * @endcode
+ */
+class TelemetryDecoder {
+public:
+    typedef std::function<void(const TelemetryRecord &record, uint16_t sequence)> Handler;
+
+    /** Construct the decoder.
+     *
+     * @param handler called with every record that decodes cleanly, in order
+     */
+    explicit TelemetryDecoder(Handler handler);
+
+    /** Decode received bytes, calling the handler for each complete record.
+     *
+     * @param data bytes from the port
+     * @param length number of bytes
+     */
+    void feed(const uint8_t *data, size_t length);
+
+    /// records decoded
+    unsigned long records() const { return _records; }
+    /// frames rejected by the CRC, by COBS or as too long
+    unsigned long bad_frames() const { return _bad_frames; }
+    /// frames with a valid CRC but an unknown type or wrong length
+    unsigned long unknown() const { return _unknown; }
+    /// frames missing from the sequence numbers
+    unsigned long lost() const { return _lost; }
+    /// samples skipped after a loss until their sensor's next keyframe
+    unsigned long unsynced() const { return _samples.unsynced(); }
+
+private:
+    void frame_done(size_t payload);
+
+    Handler _handler;
+    SampleDecoder _samples;
+    uint8_t _frame[DECODER_MAX_FRAME];
+    FrameReceiver _receiver;
+    bool _synced;           // a sequence number has been seen, so gaps can be counted
+    uint16_t _next_sequence;
+    unsigned long _records;
+    unsigned long _bad_frames;
+    unsigned long _unknown;
+    unsigned long _lost;
+};
+
+#endif
@@ -0,0 +1,74 @@
+// Print the climate monitor's telemetry stream as text
+//
+// Reads a capture (or the port itself) and prints one line per record, then
+// the decoder's error counts. Build and run from this directory:
+//
+//   g++ -std=c++14 -O2 -I.. telemetry_dump.cpp telemetry_decoder.cpp ../frame.cpp ../telemetry_record.cpp ../sample_codec.cpp -o telemetry_dump
+//   stty -F /dev/ttyACM0 115200 raw && ./telemetry_dump /dev/ttyACM0
+
+#include "telemetry_decoder.h"
+#include <cstdio>
+
+// Purpose: print tenths with one decimal place
+static void print_tenths(int tenths) {
+    int magnitude = tenths < 0 ? -tenths : tenths;
+    printf("%s%d.%d", tenths < 0 ? "-" : "", magnitude / 10, magnitude % 10);
+}
+
+// Purpose: print one record
+static void print_record(const TelemetryRecord &record, uint16_t sequence) {
+    printf("%5u %10lu ms  ", sequence, (unsigned long)record.time_ms);
+    switch (record.type) {
+        case TELEMETRY_SAMPLE:
+            printf("sample  sensor %u ", record.sample.sensor);
+            if (!record.sample.valid) {
+                printf("no reading\n");
+                break;
+            }
+            print_tenths(record.sample.celcius);
+            printf(" C  ");
+            print_tenths(record.sample.humidity);
+            printf(" %%RH\n");
+            break;
+        case TELEMETRY_ALERT:
+            printf("alert   reason %u\n", record.alert.reason);
+            break;
+        case TELEMETRY_DIAG:
+            printf("diag    busy %u.%u %%, sleep %u.%u %%, stop %u.%u %%, heap %lu B, %lu reads, %lu uA, %lu dropped\n",
+                   record.diag.busy / 10, record.diag.busy % 10, record.diag.sleep / 10, record.diag.sleep % 10,
+                   record.diag.stop / 10, record.diag.stop % 10, (unsigned long)record.diag.heap,
+                   (unsigned long)record.diag.reads, (unsigned long)record.diag.average_ua,
+                   (unsigned long)record.diag.dropped);
+            break;
+        case TELEMETRY_REPLY:
+            printf("reply   command 0x%02x, tag %u, status %u, %lu us", record.reply.command, record.reply.tag,
+                   record.reply.status, (unsigned long)record.reply.latency_us);
+            for (uint8_t i = 0; i < record.reply.count; i++) {
+                printf(" %ld", (long)record.reply.values[i]);
+            }
+            printf("\n");
+            break;
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    FILE *input = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (input == nullptr) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    TelemetryDecoder decoder(print_record);
+    uint8_t buffer[256];
+    size_t n;
+    unsigned long bytes = 0;
+    while ((n = fread(buffer, 1, sizeof(buffer), input)) > 0) {
+        decoder.feed(buffer, n);
+        bytes += n;
+    }
+    fprintf(stderr, "%lu records in %lu bytes (%.1f per record), %lu bad frames, %lu unknown, %lu lost, %lu unsynced\n",
+            decoder.records(), bytes, decoder.records() ? (double)bytes / decoder.records() : 0.0, decoder.bad_frames(),
+            decoder.unknown(), decoder.lost(), decoder.unsynced());
+    return 0;
+}
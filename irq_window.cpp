@@ -0,0 +1,51 @@
+// Interrupt masked timing windows for the climate monitor
+
+#include "irq_window.h"
+
+std::atomic<uint32_t> IrqWindow::_windows(0);
+std::atomic<uint32_t> IrqWindow::_deferred(0);
+std::atomic<uint32_t> IrqWindow::_max_us(0);
+
+// Purpose: true if an enabled interrupt or SysTick (the kernel tick of a build without MBED_TICKLESS) is waiting for the window to close
+static bool irq_pending() {
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(NVIC->ISPR) / sizeof(NVIC->ISPR[0]); i++) {
+        if (NVIC->ISPR[i] & NVIC->ISER[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+IrqWindow::IrqWindow(uint32_t priority) : _basepri(__get_BASEPRI()), _masked(priority != 0) {
+    if (_masked) {
+        // BASEPRI holds the priority in the top bits, like the NVIC priority registers
+        __set_BASEPRI(priority << (8 - __NVIC_PRIO_BITS));
+    }
+    _start_us = us_ticker_read();
+}
+
+IrqWindow::~IrqWindow() {
+    if (!_masked) {
+        return;
+    }
+    uint32_t length = us_ticker_read() - _start_us;
+    bool pending = irq_pending();
+    __set_BASEPRI(_basepri);    // pending interrupts are taken from here
+
+    _windows++;
+    if (pending) {
+        _deferred++;
+    }
+    // only t_monitor opens windows, but the report reads the maximum from t_diag
+    uint32_t longest = _max_us;
+    while (length > longest && !_max_us.compare_exchange_weak(longest, length)) {
+    }
+}
+
+void IrqWindow::report() {
+    printf("irq window: %lu windows, longest %lu us, %lu held off an interrupt\n", (unsigned long)_windows.load(),
+           (unsigned long)_max_us.load(), (unsigned long)_deferred.load());
+}
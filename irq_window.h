@@ -0,0 +1,64 @@
+// Interrupt masked timing windows for the climate monitor
+//
+// A bit-banged sensor frame is timed by busy-waiting on the pin, so any
+// interrupt taken in the middle of it stretches a pulse. An IrqWindow masks
+// every interrupt of a given NVIC priority and below (BASEPRI) for its
+// lifetime, and leaves the more urgent ones (us ticker, serial, I2C) running.
+// An edge that arrives while masked is latched as pending by the NVIC and its
+// ISR runs as soon as the window closes, so nothing is lost; it is only late
+// by at most the length of the window, which is measured.
+//
+// What is held off is set by priority alone. The keypad column interrupts
+// are put at sensor-mask-priority so they wait. The RTOS's own SVC and
+// PendSV exceptions sit at the lowest priority, so they wait as well, and
+// nothing inside a window may call into the RTOS. The kernel tick is not
+// held off: with MBED_TICKLESS there is no SysTick, the OS runs from the
+// low power ticker (LPTIM1), whose interrupt the HAL leaves at priority 0.
+// It still fires mid-frame, and only the thread switch it asks for (a
+// PendSV) waits for the window to close.
+
+#ifndef IRQ_WINDOW_H
+#define IRQ_WINDOW_H
+
+#include "mbed.h"
+#include <atomic>
+
+/** RAII guard that masks the interrupts at or below a priority.
+ *
+ * Example:
+ * @code
+ * NVIC_SetPriority(EXTI0_IRQn, 8);     // keypad column, may wait out a frame
+ * {
+ *     IrqWindow window(8);             // EXTI0, PendSV and anything else at 8 - 15 are held off
+ *     ...                              // time the frame
+ * }                                    // held off interrupts run here
+ * @endcode
+ */
+class IrqWindow {
+public:
+    /** Open the window.
+     *
+     * @param priority NVIC priority (as given to NVIC_SetPriority) masked with every lower one, 0 masks nothing
+     */
+    explicit IrqWindow(uint32_t priority);
+
+    /** Close the window, count it and let the held off interrupts run. */
+    ~IrqWindow();
+
+    /** Print how many windows were opened, the longest one (the worst case
+     * latency they added to a masked interrupt) and how many of them held
+     * off an interrupt.
+     */
+    static void report();
+
+private:
+    uint32_t _basepri;      // BASEPRI before the window, restored on close
+    uint32_t _start_us;
+    bool _masked;
+
+    static std::atomic<uint32_t> _windows;
+    static std::atomic<uint32_t> _deferred;     // windows that closed with an interrupt pending
+    static std::atomic<uint32_t> _max_us;
+};
+
+#endif
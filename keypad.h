@@ -0,0 +1,332 @@
+// Keypad matrix driver for the climate monitor
+//
+// Rows are driven from consecutive pins of one GPIO port, columns are
+// InterruptIn pins with pull downs. While no key is down every row is powered
+// and the thread using the keypad sleeps; the first key to close a circuit
+// raises its column interrupt and wakes it. From then on the whole matrix is
+// scanned row by row into a bitmask until every key is released again, so
+// any number of keys can be held at once and each one gets its own press and
+// release event. A key that stays down also reports a long press and then
+// repeats, timed from the scan timestamps, so holding a key costs a scan
+// every few milliseconds and nothing at all once it is released.
+
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include "mbed.h"
+#include <utility>
+
+#define KEYPAD_DEBOUNCE_SCANS 3     // scans a new matrix state must be seen for before it is accepted
+#define KEYPAD_SETTLE_US 10         // time for a column to follow a newly powered row
+#define KEYPAD_LONG_PRESS_MS 500    // default time a key is held before KEY_LONG
+#define KEYPAD_REPEAT_MS 100        // default time between KEY_REPEATs after KEY_LONG, 0 for none
+
+// key event types
+#define KEY_PRESS 0
+#define KEY_RELEASE 1
+#define KEY_LONG 2                  // key held for the long press time, reported once per press
+#define KEY_REPEAT 3                // key still held, reported every repeat time after KEY_LONG
+
+/// one key going down, up or being held
+struct KeyEvent {
+    char key;
+    uint8_t type;       // KEY_PRESS, KEY_RELEASE, KEY_LONG or KEY_REPEAT
+    bool held;          // KEY_LONG has been reported for this press, so a release ends a long press
+    uint32_t time_ms;   // Kernel clock time of the scan that saw it
+};
+
+/** Driver for a Rows x Cols keypad matrix with n-key rollover.
+ *
+ * Everything that depends on the wiring is computed at compile time: the
+ * keymap is a constexpr table and the register values that power each row
+ * are constants.
+ *
+ * A keypad without diodes cannot tell three keys on the corners of a
+ * rectangle from four: the fourth corner is a "ghost". Whenever two rows
+ * share two or more pressed columns the scan is ambiguous, so new presses are
+ * held back (releases are still reported) until the pattern clears, and the
+ * scan is counted in ghost_scans().
+ *
+ * Long press and repeat times are measured from the scan that accepted the
+ * press, so their resolution is the scan period.
+ *
+ * Example:
+ * @code
+ * constexpr char keymap[4][4] = {{'1','2','3','A'}, {'4','5','6','B'}, {'7','8','9','C'}, {'*','0','#','D'}};
+ * const PinName columns[4] = {PC_0, PC_3, PC_1, PC_4};
+ * KeypadMatrix<4, 4, keymap, 12> keypad(GPIOF, columns, callback(key_event));   // rows on PF_12..PF_15
+ *
+ * int main() {
+ *     keypad.begin();
+ *     while (true) {
+ *         keypad.wait_for_activity(1000ms);
+ *         while (keypad.scan()) {
+ *             ThisThread::sleep_for(5ms);
+ *         }
+ *     }
+ * }
+ * @endcode
+ *
+ * @tparam Rows number of rows, driven by the driver
+ * @tparam Cols number of columns, read by the driver
+ * @tparam Keymap character reported for each (row, column)
+ * @tparam FirstRowPin pin number of row 0 on the row port, row r is on pin FirstRowPin + r
+ */
+template <size_t Rows, size_t Cols, const char (&Keymap)[Rows][Cols], unsigned FirstRowPin>
+class KeypadMatrix {
+    static_assert(Rows > 0 && Cols > 0, "keypad needs at least one row and one column");
+    static_assert(FirstRowPin + Rows <= 16, "rows must fit on one 16 pin GPIO port");
+    static_assert(Cols <= 32, "each row is scanned into a 32 bit mask");
+
+public:
+    /** Construct the keypad driver.
+     *
+     * @param row_port GPIO port the rows are connected to, its clock must already be enabled
+     * @param column_pins pin for each column, in keymap order
+     * @param on_key called from scan() with every press and release
+     */
+    KeypadMatrix(GPIO_TypeDef *row_port, const PinName (&column_pins)[Cols], Callback<void(KeyEvent)> on_key)
+        : KeypadMatrix(row_port, column_pins, on_key, std::make_index_sequence<Cols>()) {
+    }
+
+    /** Set the long press and repeat times.
+     *
+     * @param long_press time a key is held before KEY_LONG is reported
+     * @param repeat time between KEY_REPEATs while the key stays down, 0 to report KEY_LONG only
+     */
+    void set_timing(std::chrono::milliseconds long_press, std::chrono::milliseconds repeat) {
+        _long_press_ms = long_press.count();
+        _repeat_ms = repeat.count();
+    }
+
+    /** Set the NVIC priority of the column interrupts.
+     *
+     * Columns sharing an EXTI line group (5-9, 10-15) share the group's
+     * interrupt, which takes the priority too. A column edge only wakes the
+     * scanning thread, so a low priority lets it wait out timing critical
+     * code that masks it (see IrqWindow).
+     *
+     * @param priority NVIC priority, 0 is the most urgent
+     */
+    void set_irq_priority(uint32_t priority) {
+        for (size_t col = 0; col < Cols; col++) {
+            NVIC_SetPriority(column_irq(_column_pins[col]), priority);
+        }
+    }
+
+    /** Configure the row pins as outputs and wait for the first key. */
+    void begin() {
+        _row_port->MODER = (_row_port->MODER & ~MODER_MASK) | MODER_OUTPUT;
+        for (size_t col = 0; col < Cols; col++) {
+            _columns[col].rise(callback(this, &KeypadMatrix::on_column));
+        }
+        arm();
+    }
+
+    /** Sleep until a key goes down.
+     *
+     * @param timeout longest time to sleep
+     * @returns
+     *   true if a key went down and scan() should be called, false on timeout
+     */
+    bool wait_for_activity(std::chrono::milliseconds timeout) {
+        return _activity.try_acquire_for(timeout);
+    }
+
+    /** Scan the whole matrix once, debounce it and report what changed.
+     *
+     * Call periodically after wait_for_activity() returns true, for as long
+     * as this returns true. Key events are reported from here, on the
+     * calling thread.
+     *
+     * @returns
+     *   true while any key is down, false once all keys are released and the
+     *   driver is waiting for activity again
+     */
+    bool scan() {
+        uint32_t raw[Rows];
+        for (size_t row = 0; row < Rows; row++) {
+            _row_port->ODR = (_row_port->ODR & ~ROW_MASK) | row_bit(row);
+            wait_us(KEYPAD_SETTLE_US);
+            uint32_t bits = 0;
+            for (size_t col = 0; col < Cols; col++) {
+                bits |= (uint32_t)_columns[col].read() << col;
+            }
+            raw[row] = bits;
+        }
+
+        uint32_t now_ms = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+
+        // debounce: a new matrix state is accepted once it has been read KEYPAD_DEBOUNCE_SCANS times in a row
+        if (memcmp(raw, _raw, sizeof(raw)) != 0) {
+            memcpy(_raw, raw, sizeof(raw));
+            _stable_scans = 1;
+        }
+        else if (_stable_scans < KEYPAD_DEBOUNCE_SCANS) {
+            _stable_scans++;
+            if (_stable_scans == KEYPAD_DEBOUNCE_SCANS) {
+                accept(raw, now_ms);
+            }
+        }
+
+        bool any_down = false;
+        for (size_t row = 0; row < Rows; row++) {
+            any_down |= (raw[row] | _down[row]) != 0;
+            if (_down[row]) {
+                repeat(row, now_ms);
+            }
+        }
+        if (!any_down) {
+            arm();
+            return !_idle;      // a key that went down while arming keeps us scanning
+        }
+        return true;
+    }
+
+    /** Get the number of scans that were held back because of ghosting.
+     *
+     * @returns
+     *   ambiguous scans since boot
+     */
+    uint32_t ghost_scans() const {
+        return _ghost_scans;
+    }
+
+private:
+    // bit of the row's pin in ODR
+    static constexpr uint32_t row_bit(size_t row) {
+        return 1u << (FirstRowPin + row);
+    }
+
+    // MODER bits of all row pins, and the value that makes them outputs (01 per pin)
+    static constexpr uint32_t moder_bits(uint32_t per_pin) {
+        uint32_t bits = 0;
+        for (size_t row = 0; row < Rows; row++) {
+            bits |= per_pin << (2 * (FirstRowPin + row));
+        }
+        return bits;
+    }
+
+    // EXTI interrupt of a column pin, lines 0-4 have their own, the rest are shared in two groups
+    static IRQn_Type column_irq(PinName pin) {
+        static const IRQn_Type low_lines[5] = {EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn};
+        uint32_t line = STM_PIN(pin);
+        if (line < 5) {
+            return low_lines[line];
+        }
+        return line < 10 ? EXTI9_5_IRQn : EXTI15_10_IRQn;
+    }
+
+    static constexpr uint32_t ROW_MASK = ((1u << Rows) - 1) << FirstRowPin;
+    static constexpr uint32_t MODER_MASK = moder_bits(0x3);
+    static constexpr uint32_t MODER_OUTPUT = moder_bits(0x1);
+
+    template <size_t... Col>
+    KeypadMatrix(GPIO_TypeDef *row_port, const PinName (&column_pins)[Cols], Callback<void(KeyEvent)> on_key,
+                 std::index_sequence<Col...>)
+        : _row_port(row_port), _columns{{column_pins[Col], PullDown}...}, _column_pins{column_pins[Col]...},
+          _on_key(on_key), _activity(0, 1), _raw{}, _down{}, _held{}, _due_ms{}, _stable_scans(0), _ghost_scans(0),
+          _long_press_ms(KEYPAD_LONG_PRESS_MS), _repeat_ms(KEYPAD_REPEAT_MS), _idle(false) {
+    }
+
+    // power every row so any key raises its column interrupt, then wait for one
+    void arm() {
+        _row_port->ODR |= ROW_MASK;
+        wait_us(KEYPAD_SETTLE_US);
+        _idle = true;
+        for (size_t col = 0; col < Cols; col++) {
+            _columns[col].enable_irq();
+        }
+        // a key that closed before the interrupts were enabled produced no edge
+        for (size_t col = 0; col < Cols; col++) {
+            if (_columns[col].read()) {
+                on_column();
+                break;
+            }
+        }
+    }
+
+    // shared ISR for every column: stop taking interrupts and wake the scanning thread
+    void on_column() {
+        for (size_t col = 0; col < Cols; col++) {
+            _columns[col].disable_irq();
+        }
+        _idle = false;
+        _activity.release();
+    }
+
+    // true when two rows share two or more pressed columns - the fourth corner of that rectangle may be a ghost
+    static bool has_ghost(const uint32_t (&raw)[Rows]) {
+        for (size_t a = 0; a < Rows; a++) {
+            for (size_t b = a + 1; b < Rows; b++) {
+                uint32_t shared = raw[a] & raw[b];
+                if (shared & (shared - 1)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // report every key whose debounced state changed
+    void accept(const uint32_t (&raw)[Rows], uint32_t now_ms) {
+        bool ghost = has_ghost(raw);
+        if (ghost) {
+            _ghost_scans++;
+        }
+        for (size_t row = 0; row < Rows; row++) {
+            uint32_t released = _down[row] & ~raw[row];
+            uint32_t pressed = ghost ? 0 : raw[row] & ~_down[row];
+            for (size_t col = 0; col < Cols; col++) {
+                uint32_t bit = 1u << col;
+                if (released & bit) {
+                    _on_key({Keymap[row][col], KEY_RELEASE, (_held[row] & bit) != 0, now_ms});
+                }
+                if (pressed & bit) {
+                    _due_ms[row][col] = now_ms + _long_press_ms;
+                    _on_key({Keymap[row][col], KEY_PRESS, false, now_ms});
+                }
+            }
+            _down[row] = (_down[row] & ~released) | pressed;
+            _held[row] &= _down[row];
+        }
+    }
+
+    // report KEY_LONG, then KEY_REPEAT, for the keys of a row that are due
+    void repeat(size_t row, uint32_t now_ms) {
+        for (size_t col = 0; col < Cols; col++) {
+            uint32_t bit = 1u << col;
+            if (!(_down[row] & bit) || (int32_t)(now_ms - _due_ms[row][col]) < 0) {
+                continue;
+            }
+            if (!(_held[row] & bit)) {
+                _held[row] |= bit;
+                _on_key({Keymap[row][col], KEY_LONG, true, now_ms});
+            }
+            else if (_repeat_ms) {
+                _on_key({Keymap[row][col], KEY_REPEAT, true, now_ms});
+            }
+            else {
+                continue;       // long press only
+            }
+            _due_ms[row][col] = now_ms + _repeat_ms;
+        }
+    }
+
+    GPIO_TypeDef *_row_port;
+    InterruptIn _columns[Cols];
+    PinName _column_pins[Cols];     // for the EXTI line of each column
+    Callback<void(KeyEvent)> _on_key;
+    Semaphore _activity;            // released by the column ISR
+    uint32_t _raw[Rows];            // last matrix read, one column mask per row
+    uint32_t _down[Rows];           // debounced keys that are down
+    uint32_t _held[Rows];           // keys down that have reported KEY_LONG
+    uint32_t _due_ms[Rows][Cols];   // when each key that is down reports its next KEY_LONG or KEY_REPEAT
+    uint32_t _stable_scans;         // consecutive scans _raw has been read for
+    uint32_t _ghost_scans;
+    uint32_t _long_press_ms;
+    uint32_t _repeat_ms;
+    volatile bool _idle;            // all rows powered and column interrupts enabled
+};
+
+#endif
@@ -0,0 +1,127 @@
+// Numeric entry parser for the climate monitor
+
+#include "numeric_entry.h"
+#include <stdio.h>
+
+NumericEntry::NumericEntry() {
+    begin(0, 0);
+}
+
+void NumericEntry::begin(int32_t min, int32_t max) {
+    _min = min;
+    _max = max;
+    _magnitude = 0;
+    _negative = max < 0;    // a range below zero can only be entered as a negative value
+    _digits = 0;
+    _point = false;
+    _tenth = false;
+}
+
+bool NumericEntry::digit(int digit) {
+    if (digit < 0 || digit > 9 || _tenth) {
+        return false;
+    }
+    int32_t magnitude = _point ? _magnitude + digit : _magnitude * 10 + digit * 10;
+    if (!reachable(_negative ? -magnitude : magnitude)) {
+        return false;
+    }
+    _magnitude = magnitude;
+    if (_point) {
+        _tenth = true;
+    }
+    else {
+        _digits++;
+    }
+    return true;
+}
+
+bool NumericEntry::sign() {
+    if (_negative ? _max < 0 : _min >= 0) {
+        return false;       // the range has nothing on the other side of zero
+    }
+    _negative = !_negative;
+    if (!reachable(value())) {
+        _negative = !_negative;
+        return false;
+    }
+    return true;
+}
+
+bool NumericEntry::point() {
+    if (_point) {
+        return false;
+    }
+    _point = true;
+    return true;
+}
+
+void NumericEntry::backspace() {
+    if (_tenth) {
+        _magnitude -= _magnitude % 10;
+        _tenth = false;
+    }
+    else if (_point) {
+        _point = false;
+    }
+    else if (_digits > 0) {
+        _magnitude = _magnitude / 100 * 10;
+        _digits--;
+    }
+    else {
+        _negative = _max < 0;
+    }
+}
+
+void NumericEntry::clear() {
+    begin(_min, _max);
+}
+
+void NumericEntry::add(int32_t step) {
+    int32_t value = this->value() + step;
+    if (value < _min) {
+        value = _min;
+    }
+    else if (value > _max) {
+        value = _max;
+    }
+    _negative = value < 0;
+    _magnitude = _negative ? -value : value;
+    _point = _tenth = _magnitude % 10 != 0;
+    _digits = 1;
+    for (int32_t whole = _magnitude / 10; whole >= 10; whole /= 10) {
+        _digits++;
+    }
+}
+
+int32_t NumericEntry::value() const {
+    return _negative ? -_magnitude : _magnitude;
+}
+
+bool NumericEntry::in_range() const {
+    int32_t value = this->value();
+    return (_digits > 0 || _tenth) && _min <= value && value <= _max;
+}
+
+void NumericEntry::format(char *buffer, size_t size) const {
+    const char *sign = _negative ? "-" : "";
+    long whole = _magnitude / 10;
+    if (_digits == 0 && !_point) {
+        snprintf(buffer, size, "%s", sign);
+    }
+    else if (_tenth) {
+        snprintf(buffer, size, "%s%ld.%ld", sign, whole, (long)(_magnitude % 10));
+    }
+    else {
+        snprintf(buffer, size, _point ? "%s%ld." : "%s%ld", sign, whole);
+    }
+}
+
+void NumericEntry::format_tenths(int32_t tenths, char *buffer, size_t size) {
+    long magnitude = tenths < 0 ? -(long)tenths : tenths;
+    snprintf(buffer, size, "%s%ld.%ld", tenths < 0 ? "-" : "", magnitude / 10, magnitude % 10);
+}
+
+bool NumericEntry::reachable(int32_t value) const {
+    // digits only move the value away from zero, so only the end of the range on the entry's side matters
+    return _negative ? value >= _min : value <= _max;
+}
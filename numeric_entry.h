@@ -0,0 +1,142 @@
+// Numeric entry parser for the climate monitor
+//
+// Turns keystrokes into a signed fixed-point value with one decimal place
+// as they arrive. The value is kept as an integer count of tenths, so there
+// is no string to store, no atoi and nothing to overflow: a keystroke that
+// would take the entry outside its range is refused on the spot.
+
+#ifndef NUMERIC_ENTRY_H
+#define NUMERIC_ENTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Incremental parser for a value in tenths within [min, max].
+ *
+ * Appending a digit can only move the value further from zero, so once the
+ * entry is past the end of the range on its side of zero no later keystroke
+ * can bring it back. Those keystrokes are
+ * refused. Entries that are still short of the range (a 1 on the way to 15
+ * when the minimum is 10) are accepted, and in_range() tells whether the
+ * finished value is in range.
+ *
+ * Example:
+ * @code
+ * NumericEntry entry;
+ * entry.begin(-400, 800);      // -40.0 to 80.0
+ * entry.sign();                // -
+ * entry.digit(1);              // -1
+ * entry.digit(8);              // -18
+ * entry.point();               // -18.
+ * entry.digit(5);              // -18.5
+ * if (entry.in_range()) {
+ *     int tenths = entry.value();      // -185
+ * }
+ * @endcode
+ */
+class NumericEntry {
+public:
+    NumericEntry();
+
+    /** Start a new, empty entry.
+     *
+     * @param min smallest accepted value, in tenths
+     * @param max largest accepted value, in tenths
+     */
+    void begin(int32_t min, int32_t max);
+
+    /** Append a digit, to the whole part or to the tenths after point().
+     *
+     * @param digit 0 - 9
+     * @returns
+     *   true if accepted, false if it would leave the range or the tenth is already entered
+     */
+    bool digit(int digit);
+
+    /** Flip the sign of the entry.
+     *
+     * @returns
+     *   true if accepted, false if the other side of zero is outside the range
+     */
+    bool sign();
+
+    /** Start the tenths part of the entry.
+     *
+     * @returns
+     *   true if accepted, false if the entry already has a decimal point
+     */
+    bool point();
+
+    /** Undo the last digit or decimal point, or the sign once the entry is empty. */
+    void backspace();
+
+    /** Empty the entry, keeping its range. */
+    void clear();
+
+    /** Change the value by step tenths, clamped to the range.
+     *
+     * @param step amount to add, in tenths
+     */
+    void add(int32_t step);
+
+    /** Get the value entered so far.
+     *
+     * @returns
+     *   the value in tenths, 0 for an empty entry
+     */
+    int32_t value() const;
+
+    /** Get the smallest accepted value.
+     *
+     * @returns
+     *   min passed to begin(), in tenths
+     */
+    int32_t min() const {
+        return _min;
+    }
+
+    /** Get the largest accepted value.
+     *
+     * @returns
+     *   max passed to begin(), in tenths
+     */
+    int32_t max() const {
+        return _max;
+    }
+
+    /** Check whether the value entered so far is within the range.
+     *
+     * @returns
+     *   true if min <= value() <= max and the entry is not empty
+     */
+    bool in_range() const;
+
+    /** Format the entry as typed, e.g. "-18.", "-18.5", "" when empty.
+     *
+     * @param buffer destination, always null terminated
+     * @param size size of buffer
+     */
+    void format(char *buffer, size_t size) const;
+
+    /** Format a value in tenths as [-]whole.tenth, e.g. "-18.5".
+     *
+     * @param tenths value to format
+     * @param buffer destination, always null terminated
+     * @param size size of buffer
+     */
+    static void format_tenths(int32_t tenths, char *buffer, size_t size);
+
+private:
+    // true if an entry with this value could still end up within the range by appending to it
+    bool reachable(int32_t value) const;
+
+    int32_t _min;
+    int32_t _max;
+    int32_t _magnitude;     // absolute value in tenths
+    bool _negative;
+    uint8_t _digits;        // whole part digits typed, so backspace knows when the entry is empty
+    bool _point;            // decimal point typed
+    bool _tenth;            // digit after the decimal point typed
+};
+
+#endif
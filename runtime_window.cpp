@@ -0,0 +1,36 @@
+// Sampled per-thread runtime accounting
+
+#include "runtime_window.h"
+
+uint32_t runtime_permille(uint64_t part, uint64_t whole) {
+    return whole ? (uint32_t)((part * 1000) / whole) : 0;
+}
+
+RuntimeWindow::RuntimeWindow() : _slots(), _used(0), _total(0), _unattributed(0) {
+}
+
+void RuntimeWindow::charge(void *thread) {
+    _total++;
+    for (size_t i = 0; i < _used; i++) {
+        if (_slots[i].thread == thread) {
+            _slots[i].samples++;
+            return;
+        }
+    }
+    if (_used == DIAG_MAX_THREADS) {
+        _unattributed++;
+        return;
+    }
+    _slots[_used].thread = thread;
+    _slots[_used].samples = 1;
+    _used++;
+}
+
+void RuntimeWindow::take(RuntimeWindow &finished) {
+    finished = *this;
+    for (size_t i = 0; i < _used; i++) {
+        _slots[i].samples = 0;      // keep the thread so slots stay stable between windows
+    }
+    _total = 0;
+    _unattributed = 0;
+}
@@ -0,0 +1,92 @@
+// Sampled per-thread runtime accounting
+//
+// The RTOS does not keep per-thread run time, so diagnostics.cpp samples it:
+// a ticker charges each tick to whichever thread it interrupted. This file
+// holds the bookkeeping, one window of samples per report, and the
+// arithmetic that turns them into shares of the core.
+//
+// This file only depends on the C library so the host tools build it too.
+
+#ifndef RUNTIME_WINDOW_H
+#define RUNTIME_WINDOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DIAG_MAX_THREADS 8      // number of distinct threads the sampler can attribute time to
+
+/** Convert part/whole to tenths of a percent, rounding down.
+ *
+ * @returns
+ *   part * 1000 / whole, 0 if whole is 0
+ */
+uint32_t runtime_permille(uint64_t part, uint64_t whole);
+
+/** Samples charged to each thread over one report window.
+ *
+ * A thread gets a slot the first time it is sampled and keeps it from then
+ * on, so its line stays in the same place in every report. Samples of
+ * threads that find every slot taken are counted as unattributed.
+ *
+ * Not synchronised: the sampler ISR calls charge(), the reporting thread
+ * calls take() inside a critical section.
+ *
+ * Example:
+ * @code
+ * RuntimeWindow window;           // filled by the sampler
+ * RuntimeWindow finished;
+ * core_util_critical_section_enter();
+ * window.take(finished);
+ * core_util_critical_section_exit();
+ * for (size_t i = 0; i < finished.threads(); i++) {
+ *     printf("%s %lu permille\n", osThreadGetName(finished.thread(i)),
+ *            (unsigned long)runtime_permille(finished.samples(i), finished.total()));
+ * }
+ * @endcode
+ */
+class RuntimeWindow {
+public:
+    RuntimeWindow();
+
+    /** Charge one sample to a thread.
+     *
+     * @param thread the running thread's id, never null
+     */
+    void charge(void *thread);
+
+    /** End the window: copy it into finished and start a new one.
+     *
+     * Sample counts start again from 0, thread slots are kept.
+     *
+     * @param finished receives the window that just ended
+     */
+    void take(RuntimeWindow &finished);
+
+    /// number of threads that have a slot
+    size_t threads() const { return _used; }
+
+    /// id of the thread in a slot, below threads()
+    void *thread(size_t slot) const { return _slots[slot].thread; }
+
+    /// samples charged to the thread in a slot
+    uint32_t samples(size_t slot) const { return _slots[slot].samples; }
+
+    /// samples charged to threads that found no free slot
+    uint32_t unattributed() const { return _unattributed; }
+
+    /// samples taken in the window
+    uint32_t total() const { return _total; }
+
+private:
+    struct Slot {
+        void *thread;
+        uint32_t samples;
+    };
+
+    Slot _slots[DIAG_MAX_THREADS];
+    size_t _used;
+    uint32_t _total;
+    uint32_t _unattributed;
+};
+
+#endif
@@ -0,0 +1,140 @@
+// Delta coded sample batches for the telemetry stream
+
+#include "sample_codec.h"
+
+// Purpose: put an unsigned value 7 bits at a time, lowest first, the top bit set on all but the last byte
+static void put_varint(uint32_t value, FrameEncoder &frame) {
+    while (value >= 0x80) {
+        frame.put((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    frame.put(value);
+}
+
+// Purpose: read a varint, false if it runs past the end of the payload or over 32 bits
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint32_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) {
+            return false;
+        }
+        uint8_t byte = *p++;
+        if (shift == 28 && (byte & 0x70)) {
+            return false;       // the fifth byte only has 4 bits left
+        }
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SampleEncoder::SampleEncoder() : _channels(), _time(0) {
+}
+
+void SampleEncoder::begin(uint16_t sequence, uint32_t time_ms, FrameEncoder &frame) {
+    frame.put(TELEMETRY_SAMPLES);
+    frame.put_u16(sequence);
+    frame.put_u32(time_ms);
+    _time = time_ms;
+}
+
+void SampleEncoder::add(const TelemetryRecord &sample, FrameEncoder &frame) {
+    Channel &channel = _channels[sample.sample.sensor];
+    uint8_t flags = sample.sample.sensor;
+    bool keyframe = !channel.known || channel.since_keyframe >= SAMPLE_KEYFRAME_INTERVAL;
+    if (!sample.sample.valid) {
+        flags |= SAMPLE_INVALID;
+    }
+    else if (keyframe) {
+        flags |= SAMPLE_KEYFRAME;
+    }
+    frame.put(flags);
+    put_varint(zigzag_encode(sample.time_ms - _time), frame);
+    _time = sample.time_ms;
+    if (!sample.sample.valid) {
+        return;         // nothing to send, and the last good reading stays the base for the next delta
+    }
+
+    if (keyframe) {
+        put_varint(zigzag_encode(sample.sample.celcius), frame);
+        put_varint(sample.sample.humidity, frame);
+        channel.known = true;
+        channel.since_keyframe = 0;
+    }
+    else {
+        put_varint(zigzag_encode(sample.sample.celcius - channel.celcius), frame);
+        put_varint(zigzag_encode(sample.sample.humidity - channel.humidity), frame);
+        channel.since_keyframe++;
+    }
+    channel.celcius = sample.sample.celcius;
+    channel.humidity = sample.sample.humidity;
+}
+
+SampleDecoder::SampleDecoder() : _channels(), _unsynced(0) {
+}
+
+void SampleDecoder::reset() {
+    for (Channel &channel : _channels) {
+        channel.known = false;
+    }
+}
+
+int SampleDecoder::parse(const uint8_t *payload, size_t length, uint16_t &sequence, TelemetryRecord *samples,
+                         size_t max) {
+    if (length < TELEMETRY_HEADER_SIZE || payload[0] != TELEMETRY_SAMPLES) {
+        return -1;
+    }
+    sequence = frame_get_u16(payload + 1);
+    uint32_t time = frame_get_u32(payload + 3);
+
+    const uint8_t *p = payload + TELEMETRY_HEADER_SIZE;
+    const uint8_t *end = payload + length;
+    size_t count = 0;
+    while (p < end) {
+        uint8_t flags = *p++;
+        size_t sensor = flags & SAMPLE_SENSOR_MASK;
+        uint32_t dt;
+        if (sensor >= SAMPLE_MAX_SENSORS || !get_varint(p, end, dt)) {
+            return -1;
+        }
+        time += zigzag_decode(dt);
+        Channel &channel = _channels[sensor];
+
+        TelemetryRecord sample;
+        sample.type = TELEMETRY_SAMPLE;
+        sample.time_ms = time;
+        sample.sample.sensor = sensor;
+        sample.sample.valid = !(flags & SAMPLE_INVALID);
+        sample.sample.celcius = 0;
+        sample.sample.humidity = 0;
+        if (sample.sample.valid) {
+            uint32_t celcius;
+            uint32_t humidity;
+            if (!get_varint(p, end, celcius) || !get_varint(p, end, humidity)) {
+                return -1;
+            }
+            if (flags & SAMPLE_KEYFRAME) {
+                channel.celcius = zigzag_decode(celcius);
+                channel.humidity = humidity;
+                channel.known = true;
+            }
+            else if (channel.known) {
+                channel.celcius += zigzag_decode(celcius);
+                channel.humidity += zigzag_decode(humidity);
+            }
+            else {
+                _unsynced++;
+                continue;       // a delta against a reading this decoder never saw
+            }
+            sample.sample.celcius = channel.celcius;
+            sample.sample.humidity = channel.humidity;
+        }
+        if (count == max) {
+            return -1;
+        }
+        samples[count++] = sample;
+    }
+    return count;
+}
@@ -0,0 +1,131 @@
+// Delta coded sample batches for the telemetry stream
+//
+// A TELEMETRY_SAMPLES frame carries one or more samples after the usual
+// header, whose time_ms is the time of the first sample. Each entry is:
+//
+//   flags     u8      sensor number in the low 6 bits, SAMPLE_KEYFRAME, SAMPLE_INVALID
+//   dt        varint  ms since the previous entry (the header time for the first)
+//   celcius   varint  keyframe: the reading, otherwise the change since the sensor's last reading
+//   humidity  varint  as celcius
+//
+// Varints are little endian base 128 of the zigzag coded value, so small
+// changes of either sign take one byte. An invalid entry has no values.
+//
+// A delta only means something to a receiver that saw the sensor's previous
+// reading, so the encoder sends a keyframe for a sensor the first time and
+// then every SAMPLE_KEYFRAME_INTERVAL samples. A receiver that misses a frame
+// resets its decoder and picks each sensor up again at its next keyframe.
+//
+// Like frame.h this file only depends on the C library so the host decoder
+// shares it.
+
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include "telemetry_record.h"
+
+#define SAMPLE_MAX_SENSORS 8            // sensors the codec keeps a base for, as many as one scheduler staggers
+#define SAMPLE_KEYFRAME_INTERVAL 16     // samples of one sensor between two keyframes
+#define SAMPLE_BATCH_MAX 8              // samples in one frame
+#define SAMPLE_MAX_ENTRY 12             // flags, dt up to 5 bytes, both values up to 3 bytes
+
+// entry flags
+#define SAMPLE_KEYFRAME 0x80
+#define SAMPLE_INVALID 0x40
+#define SAMPLE_SENSOR_MASK 0x3F
+
+/** Zigzag code a signed value so small magnitudes of either sign stay small. */
+inline uint32_t zigzag_encode(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/** Undo zigzag_encode(). */
+inline int32_t zigzag_decode(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/** Packs samples into delta coded batches.
+ *
+ * Keeps each sensor's last reading between frames, so one encoder must see
+ * every sample that is sent, in order.
+ *
+ * Example:
+ * @code
+ * SampleEncoder samples;
+ * FrameEncoder frame(tx, sizeof(tx));
+ * samples.begin(sequence++, first.time_ms, frame);
+ * samples.add(first, frame);
+ * samples.add(second, frame);         // up to SAMPLE_BATCH_MAX
+ * serial.write(tx, frame.finish());
+ * @endcode
+ */
+class SampleEncoder {
+public:
+    SampleEncoder();
+
+    /** Start a batch by writing the frame header.
+     *
+     * @param sequence the frame's sequence number
+     * @param time_ms time of the first sample in the batch
+     * @param frame encoder the payload is put into
+     */
+    void begin(uint16_t sequence, uint32_t time_ms, FrameEncoder &frame);
+
+    /** Add a sample to the batch started by begin().
+     *
+     * @param sample a TELEMETRY_SAMPLE record, its sensor below SAMPLE_MAX_SENSORS
+     * @param frame the encoder passed to begin()
+     */
+    void add(const TelemetryRecord &sample, FrameEncoder &frame);
+
+private:
+    struct Channel {
+        int16_t celcius;
+        uint16_t humidity;
+        uint8_t since_keyframe;     // deltas sent since the last keyframe
+        bool known;                 // a keyframe has been sent
+    };
+
+    Channel _channels[SAMPLE_MAX_SENSORS];
+    uint32_t _time;                 // time of the previous entry in the batch
+};
+
+/** Unpacks delta coded batches.
+ *
+ * Call reset() whenever a frame may have been missed, deltas are then
+ * skipped until each sensor's next keyframe.
+ */
+class SampleDecoder {
+public:
+    SampleDecoder();
+
+    /** Forget every sensor's reading. */
+    void reset();
+
+    /** Read the samples from a decoded TELEMETRY_SAMPLES frame payload.
+     *
+     * @param payload bytes returned by frame_decode()
+     * @param length payload length
+     * @param sequence receives the frame's sequence number
+     * @param samples receives the samples as TELEMETRY_SAMPLE records
+     * @param max room in samples, SAMPLE_BATCH_MAX is always enough for the firmware's frames
+     * @returns
+     *   number of samples read, or -1 if the payload is malformed
+     */
+    int parse(const uint8_t *payload, size_t length, uint16_t &sequence, TelemetryRecord *samples, size_t max);
+
+    /// deltas skipped because their sensor's last reading was not known
+    unsigned long unsynced() const { return _unsynced; }
+
+private:
+    struct Channel {
+        int16_t celcius;
+        uint16_t humidity;
+        bool known;
+    };
+
+    Channel _channels[SAMPLE_MAX_SENSORS];
+    unsigned long _unsynced;
+};
+
+#endif
@@ -0,0 +1,184 @@
+// Staggered read scheduler for the climate sensors
+
+#include "sensor_scheduler.h"
+
+// Purpose: Kernel clock time in milliseconds, wraps after 49 days which the unsigned differences below tolerate
+static uint32_t now_ms() {
+    return (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+}
+
+SensorScheduler::SensorScheduler(size_t channels, std::chrono::milliseconds interval, Callback<int(size_t)> read,
+                                 Callback<void(size_t)> lost)
+    : _channels(channels), _interval(interval), _read(read), _lost(lost), _next(0), _window_ok(0),
+      _window_start_ms(0) {
+    MBED_ASSERT(channels > 0 && channels <= SCHEDULER_MAX_CHANNELS);
+    for (size_t i = 0; i < SCHEDULER_MAX_CHANNELS; i++) {
+        Channel &stats = _stats[i];
+        stats.ok = 0;
+        stats.checksum = 0;
+        stats.timeout = 0;
+        stats.bus = 0;
+        stats.last_ok_ms = 0;
+        stats.ever_ok = false;
+        stats.backoff = 0;
+        stats.every = 1;
+        stats.saved = 0;
+        stats.failures = 0;
+        stats.skip = 0;
+        stats.early_ms = 0;
+        stats.early = false;
+    }
+    for (size_t i = 0; i < SENSOR_LATENCY_BUCKETS; i++) {
+        _latency[i] = 0;
+    }
+}
+
+void SensorScheduler::start(EventQueue &queue) {
+    // reads must not run into each other, or a sensor misses its start signal
+    MBED_ASSERT(slot().count() >= SENSOR_READ_WINDOW_MS);
+    _window_start_ms = now_ms();
+    queue.call_every(slot(), callback(this, &SensorScheduler::step));
+}
+
+int SensorScheduler::read_now(size_t channel) {
+    uint32_t start = us_ticker_read();
+    int status = _read(channel);
+    record(channel, status, us_ticker_read() - start);
+    if (status != SENSOR_ERROR_INTERVAL) {
+        _stats[channel].early_ms = now_ms();
+        _stats[channel].early = true;
+    }
+    return status;
+}
+
+void SensorScheduler::set_interval(size_t channel, std::chrono::milliseconds interval) {
+    uint32_t every = (interval.count() + _interval.count() - 1) / _interval.count();
+    _stats[channel].every = every < 1 ? 1 : every > 255 ? 255 : every;
+}
+
+std::chrono::milliseconds SensorScheduler::interval(size_t channel) const {
+    const Channel &stats = _stats[channel];
+    if (stats.backoff) {
+        return _interval * (1 << stats.backoff);
+    }
+    return _interval * stats.every.load();
+}
+
+uint32_t SensorScheduler::reads() const {
+    uint32_t total = 0;
+    for (size_t i = 0; i < _channels; i++) {
+        const Channel &stats = _stats[i];
+        total += stats.ok + stats.checksum + stats.timeout + stats.bus;
+    }
+    return total;
+}
+
+std::chrono::milliseconds SensorScheduler::slot() const {
+    return _interval / _channels;
+}
+
+void SensorScheduler::step() {
+    size_t channel = _next;
+    _next = (_next + 1) % _channels;
+
+    Channel &stats = _stats[channel];
+    if (stats.early) {
+        stats.early = false;
+        if (now_ms() - stats.early_ms < _interval.count() - SENSOR_INTERVAL_JITTER_MS) {
+            return;         // read_now() got there first, the sensor would refuse this read
+        }
+    }
+    if (stats.skip > 0) {
+        stats.skip--;       // backing off or not needed yet, the slot stays idle
+        if (stats.backoff == 0) {
+            stats.saved++;
+        }
+        return;
+    }
+    uint32_t start = us_ticker_read();
+    int status = _read(channel);
+    record(channel, status, us_ticker_read() - start);
+}
+
+void SensorScheduler::record(size_t channel, int status, uint32_t latency_us) {
+    if (status == SENSOR_ERROR_INTERVAL) {
+        return;     // the sensor refused a read that came too soon, the bus was never touched
+    }
+
+    // histogram buckets double from 4 ms
+    size_t bucket = 0;
+    for (uint32_t limit_us = 4000; bucket < SENSOR_LATENCY_BUCKETS - 1 && latency_us >= limit_us; limit_us *= 2) {
+        bucket++;
+    }
+    _latency[bucket]++;
+
+    Channel &stats = _stats[channel];
+    if (status == SENSOR_OK) {
+        stats.ok++;
+        stats.last_ok_ms = now_ms();
+        stats.ever_ok = true;
+        stats.failures = 0;
+        stats.backoff = 0;
+        stats.skip = stats.every - 1;
+        _window_ok++;
+        return;
+    }
+
+    if (status == SENSOR_ERROR_CHECKSUM) {
+        stats.checksum++;
+    }
+    else if (status == SENSOR_ERROR_TIMEOUT) {
+        stats.timeout++;
+    }
+    else {
+        stats.bus++;
+    }
+
+    // retry in the channel's next slot, the sensor can not be read sooner than that
+    stats.failures++;
+    if (stats.failures == SENSOR_MAX_RETRIES && _lost) {
+        _lost(channel);
+    }
+    // a sensor that keeps timing out is probably not there, read it half as often after each further timeout
+    if (stats.failures >= SENSOR_MAX_RETRIES && status == SENSOR_ERROR_TIMEOUT) {
+        if (stats.backoff < SENSOR_MAX_BACKOFF) {
+            stats.backoff++;
+        }
+        stats.skip = (1u << stats.backoff) - 1;
+    }
+}
+
+void SensorScheduler::report() {
+    uint32_t now = now_ms();
+    uint32_t elapsed = now - _window_start_ms;
+    uint32_t ok = _window_ok.exchange(0);
+    _window_start_ms = now;
+
+    // samples per second with two decimals, integer math only
+    uint32_t centi = elapsed ? (uint32_t)((uint64_t)ok * 100000 / elapsed) : 0;
+    printf("sensors: %lu.%02lu samples/s, slot %lu ms\n", (unsigned long)(centi / 100), (unsigned long)(centi % 100),
+           (unsigned long)slot().count());
+    for (size_t i = 0; i < _channels; i++) {
+        Channel &stats = _stats[i];
+        printf("  sensor %u: %lu ok, %lu checksum, %lu timeout, %lu bus, every %lu ms, %lu reads saved, ", (unsigned)i,
+               (unsigned long)stats.ok.load(), (unsigned long)stats.checksum.load(),
+               (unsigned long)stats.timeout.load(), (unsigned long)stats.bus.load(),
+               (unsigned long)interval(i).count(), (unsigned long)stats.saved.load());
+        if (stats.ever_ok) {
+            printf("last good %lu ms ago\n", (unsigned long)(now - stats.last_ok_ms));
+        }
+        else {
+            printf("no good reading yet\n");
+        }
+    }
+    printf("  read latency:");
+    uint32_t limit_ms = 4;
+    for (size_t i = 0; i < SENSOR_LATENCY_BUCKETS; i++, limit_ms *= 2) {
+        if (i < SENSOR_LATENCY_BUCKETS - 1) {
+            printf(" <%lu ms %lu,", (unsigned long)limit_ms, (unsigned long)_latency[i].load());
+        }
+        else {
+            printf(" longer %lu\n", (unsigned long)_latency[i].load());
+        }
+    }
+}
@@ -0,0 +1,153 @@
+// Staggered read scheduler for the climate sensors
+//
+// Each sensor may only be read once per interval (2 s for the DHT family),
+// and a read bit-bangs its pin with the CPU for a few milliseconds. The
+// scheduler splits the interval into one slot per sensor and reads one
+// sensor per slot from a single thread, so every sensor is read as often as
+// it allows and no two reads ever overlap.
+//
+// How often a healthy sensor is read is up to the application: after each
+// good read it may stretch the sensor's period to any multiple of the
+// interval with set_interval(), and the slots in between stay idle.
+//
+// A failed read is retried in the sensor's next slot, one interval later.
+// After SENSOR_MAX_RETRIES failures in a row the sensor is reported lost so
+// its reading can be marked invalid, and a sensor that keeps timing out
+// (usually unplugged) is read exponentially less often so it stops costing
+// CPU time.
+
+#ifndef SENSOR_SCHEDULER_H
+#define SENSOR_SCHEDULER_H
+
+#include "mbed.h"
+#include "climate_sensor.h"
+#include <atomic>
+
+#define SCHEDULER_MAX_CHANNELS 8        // sensors one scheduler can stagger
+#define SENSOR_READ_WINDOW_MS 30        // longest one read keeps the CPU busy, a slot must be at least this long
+#define SENSOR_MAX_RETRIES 3            // failed reads in a row before the sensor is reported lost
+#define SENSOR_MAX_BACKOFF 5            // a timing out sensor is read at most every 2^5 intervals
+#define SENSOR_LATENCY_BUCKETS 6        // read latency histogram: < 4, 8, 16, 32, 64 ms and longer
+
+/** Round robin read scheduler with retries, backoff and per-channel statistics.
+ *
+ * Example:
+ * @code
+ * int read_sensor(size_t channel);    // returns SENSOR_OK or an error
+ * void sensor_lost(size_t channel);   // SENSOR_MAX_RETRIES reads in a row failed
+ * SensorScheduler scheduler(3, 2000ms, callback(read_sensor), callback(sensor_lost));
+ *
+ * int main() {
+ *     scheduler.start(queue);         // reads channel 0, 1, 2 at 0, 666 and 1333 ms, then repeats
+ *     queue.dispatch_forever();
+ * }
+ * @endcode
+ */
+class SensorScheduler {
+public:
+    /** Construct the scheduler.
+     *
+     * @param channels number of sensors, at most SCHEDULER_MAX_CHANNELS
+     * @param interval minimum time between two reads of the same sensor
+     * @param read reads one channel, returns SENSOR_OK or one of the SENSOR_ERROR codes
+     * @param lost called once when a channel has failed SENSOR_MAX_RETRIES reads in a row
+     */
+    SensorScheduler(size_t channels, std::chrono::milliseconds interval, Callback<int(size_t)> read,
+                    Callback<void(size_t)> lost);
+
+    /** Start reading, one channel every slot().
+     *
+     * The queue's dispatching thread does every read, so it should be the
+     * only thread touching the sensors.
+     *
+     * @param queue event queue that runs the reads
+     */
+    void start(EventQueue &queue);
+
+    /** Read a channel now, out of turn, for a caller that needs a fresher reading than the schedule gives.
+     *
+     * Goes through the read callback and is counted like a read in a slot,
+     * failures and lost reporting included. The channel's next slot is left
+     * idle if it comes before the sensor can be read again. Only call it from
+     * the queue passed to start().
+     *
+     * @param channel channel number
+     * @returns
+     *   the read callback's status, SENSOR_ERROR_INTERVAL if the sensor was read too recently
+     */
+    int read_now(size_t channel);
+
+    /** Set how often a channel is read while its reads succeed.
+     *
+     * Takes effect after the channel's next good read, so it can be called
+     * from the read callback. Rounded up to a whole number of intervals.
+     *
+     * @param channel channel number
+     * @param interval time between two reads of the channel, the constructor's interval or longer
+     */
+    void set_interval(size_t channel, std::chrono::milliseconds interval);
+
+    /** Get how often a channel is currently read.
+     *
+     * @param channel channel number
+     * @returns
+     *   time between two reads of the channel, including any backoff
+     */
+    std::chrono::milliseconds interval(size_t channel) const;
+
+    /** Get the number of reads that reached a sensor.
+     *
+     * @returns
+     *   reads of all channels since boot, in their slots or through read_now(), successful or not
+     */
+    uint32_t reads() const;
+
+    /** Get the time between two consecutive reads.
+     *
+     * @returns
+     *   the interval divided by the number of channels
+     */
+    std::chrono::milliseconds slot() const;
+
+    /** Print the samples per second achieved across all channels since the
+     * last report, each channel's outcomes (ok, checksum, timeout, bus), its
+     * current period and the slots it left idle, the age of its last good
+     * reading, and the read latency histogram.
+     */
+    void report();
+
+private:
+    // read the channel whose slot this is
+    void step();
+
+    // count the outcome of one read and decide when the channel is read next
+    void record(size_t channel, int status, uint32_t latency_us);
+
+    struct Channel {
+        std::atomic<uint32_t> ok;
+        std::atomic<uint32_t> checksum;
+        std::atomic<uint32_t> timeout;
+        std::atomic<uint32_t> bus;          // bus errors and anything else
+        std::atomic<uint32_t> last_ok_ms;   // Kernel clock time of the last successful read
+        std::atomic<bool> ever_ok;
+        std::atomic<uint8_t> backoff;       // the channel is read every 2^backoff slots of its own
+        std::atomic<uint8_t> every;         // a healthy channel is read every this many slots of its own
+        std::atomic<uint32_t> saved;        // own slots left idle because the channel did not need a read
+        uint32_t failures;                  // failed reads in a row, only touched by the queue thread
+        uint32_t skip;                      // own slots left to skip before the next read
+        uint32_t early_ms;                  // Kernel clock time of the last read_now() that reached the sensor
+        bool early;                         // read_now() reached the sensor since the channel's last slot
+    };
+
+    size_t _channels;
+    std::chrono::milliseconds _interval;
+    Callback<int(size_t)> _read;
+    Callback<void(size_t)> _lost;
+    size_t _next;                       // channel read in the next slot, only touched by the queue thread
+    Channel _stats[SCHEDULER_MAX_CHANNELS];
+    std::atomic<uint32_t> _latency[SENSOR_LATENCY_BUCKETS];
+    std::atomic<uint32_t> _window_ok;   // successful reads since the last report
+    uint32_t _window_start_ms;
+};
+
+#endif
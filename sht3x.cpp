@@ -0,0 +1,44 @@
+// SHT3x temperature & humidity sensor driver for the climate monitor
+
+#include "sht3x.h"
+
+#define SHT3X_MEASURE_HIGH 0x2400       // single shot, high repeatability, no clock stretching
+#define SHT3X_MEASURE_TIME 16ms         // 15.5 ms worst case for high repeatability
+
+SHT3x::SHT3x(PinName sda, PinName scl, uint8_t address) : _i2c(sda, scl), _address(address << 1) {
+}
+
+int SHT3x::read_sample(SensorSample &sample) {
+    const char command[2] = {(char)(SHT3X_MEASURE_HIGH >> 8), (char)(SHT3X_MEASURE_HIGH & 0xFF)};
+    if (_i2c.write(_address, command, sizeof(command)) != 0) {
+        return SENSOR_ERROR_BUS;
+    }
+    ThisThread::sleep_for(SHT3X_MEASURE_TIME);
+
+    // temperature MSB, LSB, CRC, humidity MSB, LSB, CRC
+    uint8_t data[6];
+    if (_i2c.read(_address, (char *)data, sizeof(data)) != 0) {
+        return SENSOR_ERROR_BUS;
+    }
+    if (crc8(&data[0], 2) != data[2] || crc8(&data[3], 2) != data[5]) {
+        return SENSOR_ERROR_CHECKSUM;
+    }
+
+    // T = -45 + 175 * raw / 65535, RH = 100 * raw / 65535, scaled to tenths and rounded
+    uint32_t raw_temperature = (data[0] << 8) | data[1];
+    uint32_t raw_humidity = (data[3] << 8) | data[4];
+    sample.celcius = -450 + (int)((raw_temperature * 1750 + 32767) / 65535);
+    sample.humidity = (int)((raw_humidity * 1000 + 32767) / 65535);
+    return SENSOR_OK;
+}
+
+uint8_t SHT3x::crc8(const uint8_t *data, size_t length) {
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,61 @@
+// SHT3x temperature & humidity sensor driver for the climate monitor
+//
+// Sensirion SHT30/31/35 on I2C, read with single shot high repeatability
+// measurements. Each result word carries its own CRC-8, which is checked
+// before the sample is accepted.
+
+#ifndef SHT3X_H
+#define SHT3X_H
+
+#include "mbed.h"
+#include "climate_sensor.h"
+
+#define SHT3X_ADDRESS_DEFAULT 0x44      // ADDR pin low, 0x45 with ADDR high
+
+/** Class for an SHT3x sensor on I2C.
+ *
+ * The mbed I2C API serializes transfers on a bus, so the sensor can share
+ * the LCD's bus.
+ *
+ * Example:
+ * @code
+ * SHT3x sensor(PB_9, PB_8);   // SDA, SCL
+ *
+ * int main() {
+ *     if (sensor.read() == SENSOR_OK) {
+ *         printf("T: %d tenths C, H: %d tenths %%\r\n", sensor.sample().celcius, sensor.sample().humidity);
+ *     }
+ * }
+ * @endcode
+ */
+class SHT3x : public ClimateSensor<SHT3x> {
+public:
+    /// a single shot takes 15 ms, reading once a second keeps self heating negligible
+    static constexpr uint32_t MIN_INTERVAL_MS = 1000;
+
+    /** Construct the sensor object.
+     *
+     * @param sda I2C data pin
+     * @param scl I2C clock pin
+     * @param address 7 bit I2C address, SHT3X_ADDRESS_DEFAULT or 0x45
+     */
+    SHT3x(PinName sda, PinName scl, uint8_t address = SHT3X_ADDRESS_DEFAULT);
+
+    /** Measure humidity and temperature, called by read().
+     *
+     * @param sample receives the values in tenths, -45.0 to 130.0 C and 0 to 100.0 %RH
+     * @returns
+     *   SENSOR_OK on success, SENSOR_ERROR_BUS if the sensor did not acknowledge,
+     *   SENSOR_ERROR_CHECKSUM if a result word failed its CRC
+     */
+    int read_sample(SensorSample &sample);
+
+private:
+    // CRC-8 of a result word: polynomial 0x31, initial value 0xFF
+    static uint8_t crc8(const uint8_t *data, size_t length);
+
+    I2C _i2c;
+    int _address;       // 8 bit address as used by the mbed I2C API
+};
+
+#endif
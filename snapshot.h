@@ -0,0 +1,148 @@
+// Versioned snapshot of a value, read without locks
+//
+// This file only depends on the C++ library so the host tools build it too.
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// called before each word of a copy is read and after each word of a write is stored; empty unless the host
+// stress test defines them to hold a thread at a chosen point
+#ifndef SNAPSHOT_LOAD_HOOK
+#define SNAPSHOT_LOAD_HOOK(word)
+#endif
+#ifndef SNAPSHOT_STORE_HOOK
+#define SNAPSHOT_STORE_HOOK(word)
+#endif
+
+/** Versioned copy-on-write snapshot of a value.
+ *
+ * The value is kept in two slots, each guarded by a sequence count that is
+ * odd while the slot is being written (a seqlock). A writer fills the slot
+ * readers are not using and then publishes it by bumping the version, whose
+ * low bit selects the current slot. A reader copies the current slot and
+ * keeps the copy only if the slot's sequence was even and unchanged around
+ * it and the version did not move; otherwise a writer touched the slot
+ * mid-copy and the read starts over from the version, which by then points
+ * at the other, complete slot. So a reader never waits for a writer that was
+ * preempted halfway, it only retries when a write completed.
+ *
+ * The slots are stored as atomic words, so a copy racing a write is never a
+ * data race, only a retry. Reads never block and never take a lock, so they
+ * are safe from any thread; writes are serialized by a Lock (anything with
+ * lock() and unlock(), rtos::Mutex on the target) and must not be made from
+ * an ISR.
+ *
+ * @tparam T trivially copyable value
+ * @tparam Lock serializes writers
+ */
+template <typename T, typename Lock>
+class Snapshot {
+    static_assert(std::is_trivially_copyable<T>::value, "a snapshot is copied word by word");
+
+public:
+    /** Construct the snapshot holding an initial value.
+     *
+     * @param initial value returned by read() until the first write()
+     */
+    Snapshot(const T &initial) : _version(0) {
+        for (Slot &slot : _slots) {
+            slot.sequence.store(0, std::memory_order_relaxed);
+            store(slot, initial);
+        }
+    }
+
+    /** Get a consistent copy of the current value.
+     *
+     * @param version if not null, receives the version of the returned copy
+     * @returns
+     *   the most recently published value
+     */
+    T read(uint32_t *version = nullptr) const {
+        while (true) {
+            uint32_t current = _version.load(std::memory_order_acquire);
+            const Slot &slot = _slots[current & 1];
+            uint32_t before = slot.sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;       // a later write is refilling it, the version now points at the other slot
+            }
+            T copy = load(slot);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // no write touched the slot while we copied it, and it still holds the version we looked it up by
+            if (slot.sequence.load(std::memory_order_relaxed) == before &&
+                _version.load(std::memory_order_relaxed) == current) {
+                if (version != nullptr) {
+                    *version = current;
+                }
+                return copy;
+            }
+        }
+    }
+
+    /** Publish a new value.
+     *
+     * @param value replaces the current value for all subsequent reads
+     */
+    void write(const T &value) {
+        _write_lock.lock();
+        uint32_t next = _version.load(std::memory_order_relaxed) + 1;
+        Slot &slot = _slots[next & 1];
+        uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);       // odd: readers of this slot retry
+        std::atomic_thread_fence(std::memory_order_release);
+        store(slot, value);
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+        _version.store(next, std::memory_order_release);
+        _write_lock.unlock();
+    }
+
+    /** Get the version of the current value, it increases by one on every write.
+     *
+     * @returns
+     *   current version
+     */
+    uint32_t version() const {
+        return _version.load(std::memory_order_acquire);
+    }
+
+private:
+    static const size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    struct Slot {
+        std::atomic<uint32_t> sequence;     // odd while the slot is being written
+        std::atomic<uint32_t> words[WORDS];
+    };
+
+    // copy a value into a slot's words
+    static void store(Slot &slot, const T &value) {
+        uint32_t words[WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+        for (size_t i = 0; i < WORDS; i++) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+            SNAPSHOT_STORE_HOOK(i);
+        }
+    }
+
+    // copy a value out of a slot's words
+    static T load(const Slot &slot) {
+        uint32_t words[WORDS];
+        for (size_t i = 0; i < WORDS; i++) {
+            SNAPSHOT_LOAD_HOOK(i);
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    Slot _slots[2];
+    std::atomic<uint32_t> _version;
+    Lock _write_lock;
+};
+
+#endif
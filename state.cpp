@@ -0,0 +1,11 @@
+// System state store for the climate monitor
+
+#include "state.h"
+
+SystemState state = {
+    {IDLE},
+    {CELCIUS},
+    {-1},
+    {{TEMP_MIN, TEMP_MAX, HUMIDITY_MIN, HUMIDITY_MAX}},
+    {{0, 0, 0, false}},     // no reading until the first sensor answers
+};
@@ -0,0 +1,52 @@
+// System state store for the climate monitor
+//
+// Every piece of state shared between the keypad ISRs, t_lcd and t_monitor
+// lives here. Small values are atomics so a single read or write is never
+// torn. Multi-field values (the threshold set and the latest reading) are
+// published as versioned snapshots (snapshot.h): writers build a complete copy
+// and swap it in, readers copy out a consistent view without taking a lock.
+
+#ifndef STATE_H
+#define STATE_H
+
+#include "mbed.h"
+#include "climate_types.h"
+#include "snapshot.h"
+#include <atomic>
+
+// limits a range can be set to, in tenths of a degree Celcius and tenths of a percent RH
+#define TEMP_MIN -400
+#define TEMP_MAX 800
+#define HUMIDITY_MIN 0
+#define HUMIDITY_MAX 1000
+
+// units of measurement
+#define FAHRENHEIT false
+#define CELCIUS true
+
+// device modes
+#define IDLE 0
+#define INPUT 1
+#define MONITOR 2
+#define ALERT 3
+
+/// one reading of a climate sensor
+struct Reading {
+    int celcius;            // tenths of a degree Celcius
+    int humidity;           // tenths of a percent RH
+    int sensor;             // which sensor it came from
+    bool valid;             // false once the sensor stopped answering, celcius and humidity are then meaningless
+};
+
+/// all state shared between ISRs and threads
+struct SystemState {
+    std::atomic<int> mode;          // IDLE, INPUT, MONITOR or ALERT
+    std::atomic<bool> unit;         // CELCIUS or FAHRENHEIT
+    std::atomic<int> input_stage;   // which input is being entered (min temp, max temp, min humidity, max humidity), -1 when none
+    Snapshot<Thresholds, Mutex> thresholds;
+    Snapshot<Reading, Mutex> reading;      // latest reading from any sensor, check valid before using it
+};
+
+extern SystemState state;
+
+#endif
@@ -0,0 +1,95 @@
+// Table driven state machine for the climate monitor
+
+#include "state_machine.h"
+
+StateMachine::StateMachine(const FsmState *states, size_t state_count,
+                           const FsmTransition *transitions, size_t transition_count,
+                           const char *const *event_names, std::atomic<int> &current)
+    : _states(states), _state_count(state_count), _transitions(transitions),
+      _transition_count(transition_count), _event_names(event_names), _current(current),
+      _log_count(0), _reported(0), _worst_reaction_us(0) {
+}
+
+const FsmState *StateMachine::find_state(int state) const {
+    for (size_t i = 0; i < _state_count; i++) {
+        if (_states[i].state == state) {
+            return &_states[i];
+        }
+    }
+    return nullptr;
+}
+
+void StateMachine::start() {
+    const FsmState *initial = find_state(_current);
+    if (initial != nullptr && initial->entry != nullptr) {
+        initial->entry();
+    }
+}
+
+void StateMachine::dispatch(int event, int arg, uint32_t posted_us) {
+    int from = _current;
+    const FsmTransition *transition = nullptr;
+    for (size_t i = 0; i < _transition_count; i++) {
+        if (_transitions[i].state == from && _transitions[i].event == event) {
+            transition = &_transitions[i];
+            break;
+        }
+    }
+    if (transition == nullptr) {
+        return;     // event has no meaning in this state
+    }
+
+    if (transition->next != from) {
+        const FsmState *old_state = find_state(from);
+        if (old_state != nullptr && old_state->exit != nullptr) {
+            old_state->exit();
+        }
+    }
+    if (transition->action != nullptr) {
+        transition->action(arg);
+    }
+    if (transition->next != from) {
+        _current = transition->next;
+        const FsmState *new_state = find_state(transition->next);
+        if (new_state != nullptr && new_state->entry != nullptr) {
+            new_state->entry();
+        }
+    }
+
+    // internal transitions (digits, samples) only count towards the reaction time, mode changes are logged
+    uint32_t reaction_us = us_ticker_read() - posted_us;
+    _log_lock.lock();
+    if (reaction_us > _worst_reaction_us) {
+        _worst_reaction_us = reaction_us;
+    }
+    if (transition->next != from) {
+        LogEntry &entry = _log[_log_count % FSM_LOG_SIZE];
+        entry.time_ms = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+        entry.from = from;
+        entry.event = event;
+        entry.to = transition->next;
+        entry.reaction_us = reaction_us;
+        _log_count++;
+    }
+    _log_lock.unlock();
+}
+
+void StateMachine::report() {
+    _log_lock.lock();
+    uint32_t first = _reported;
+    if (_log_count - first > FSM_LOG_SIZE) {
+        first = _log_count - FSM_LOG_SIZE;      // older entries have been overwritten
+    }
+    printf("state machine: %lu mode changes, worst reaction %lu us\n",
+           (unsigned long)_log_count, (unsigned long)_worst_reaction_us);
+    for (uint32_t i = first; i < _log_count; i++) {
+        const LogEntry &entry = _log[i % FSM_LOG_SIZE];
+        const FsmState *from = find_state(entry.from);
+        const FsmState *to = find_state(entry.to);
+        printf("  %8lu ms  %-8s --%s--> %-8s %6lu us\n", (unsigned long)entry.time_ms,
+               from ? from->name : "?", _event_names[entry.event], to ? to->name : "?",
+               (unsigned long)entry.reaction_us);
+    }
+    _reported = _log_count;
+    _log_lock.unlock();
+}
@@ -0,0 +1,103 @@
+// Table driven state machine for the climate monitor
+//
+// Behaviour is described by two tables: one row per state with its entry and
+// exit actions, and one row per (state, event) pair with the transition
+// action and next state. A single dispatcher walks the tables, so every mode
+// change happens in one place, on one thread, and is logged with a timestamp.
+
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include "mbed.h"
+#include <atomic>
+
+#define FSM_LOG_SIZE 16         // number of mode changes kept for report()
+
+/// entry or exit action of a state
+typedef void (*fsm_state_action_t)();
+
+/// action run on a transition, gets the argument the event was posted with
+typedef void (*fsm_action_t)(int arg);
+
+/// one state, its name and entry/exit actions (either may be null)
+struct FsmState {
+    int state;
+    const char *name;
+    fsm_state_action_t entry;
+    fsm_state_action_t exit;
+};
+
+/// one row of the transition table: in state, on event, run action (may be null) and go to next
+struct FsmTransition {
+    int state;
+    int event;
+    fsm_action_t action;
+    int next;
+};
+
+/** Table driven state machine.
+ *
+ * Events with no row for the current state are ignored. A row whose next
+ * state is the current state is an internal transition: its action runs but
+ * the exit and entry actions do not. Otherwise the order is exit action,
+ * transition action, entry action.
+ *
+ * dispatch() must always be called from the same thread (normally by
+ * posting it to that thread's EventQueue); report() may be called from any
+ * thread.
+ */
+class StateMachine {
+public:
+    /** Construct the state machine.
+     *
+     * @param states table of states, with entry and exit actions
+     * @param state_count number of rows in states
+     * @param transitions transition table
+     * @param transition_count number of rows in transitions
+     * @param event_names name of each event, indexed by event number, used by report()
+     * @param current where the current state is published for the rest of the system
+     */
+    StateMachine(const FsmState *states, size_t state_count,
+                 const FsmTransition *transitions, size_t transition_count,
+                 const char *const *event_names, std::atomic<int> &current);
+
+    /** Run the entry action of the current state. Call once before the first dispatch(). */
+    void start();
+
+    /** Process one event.
+     *
+     * @param event the event that happened
+     * @param arg passed to the transition action
+     * @param posted_us us_ticker_read() when the event was raised, used to measure reaction time
+     */
+    void dispatch(int event, int arg, uint32_t posted_us);
+
+    /** Print the mode changes made since the last report and the worst reaction time to any event. */
+    void report();
+
+private:
+    const FsmState *find_state(int state) const;
+
+    struct LogEntry {
+        uint32_t time_ms;       // Kernel clock when the transition finished
+        int from;
+        int event;
+        int to;
+        uint32_t reaction_us;   // from the event being raised to the transition finishing
+    };
+
+    const FsmState *_states;
+    size_t _state_count;
+    const FsmTransition *_transitions;
+    size_t _transition_count;
+    const char *const *_event_names;
+    std::atomic<int> &_current;
+
+    Mutex _log_lock;
+    LogEntry _log[FSM_LOG_SIZE];
+    uint32_t _log_count;        // mode changes logged since boot
+    uint32_t _reported;         // value of _log_count at the last report
+    uint32_t _worst_reaction_us;
+};
+
+#endif
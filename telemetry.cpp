@@ -0,0 +1,112 @@
+// Binary telemetry stream for the climate monitor
+
+#include "telemetry.h"
+#include "history.h"
+#include "sample_codec.h"
+#include <atomic>
+
+static BufferedSerial *telemetry_serial = nullptr;
+static MemoryPool<TelemetryRecord, TELEMETRY_QUEUE_DEPTH> record_pool;
+static Queue<TelemetryRecord, TELEMETRY_QUEUE_DEPTH> record_queue;
+static std::atomic<uint32_t> dropped(0);
+
+// largest payload: a history chunk, which is also enough for a full batch of samples or any single record
+#define TX_PAYLOAD_MAX HISTORY_PAYLOAD
+static_assert(TX_PAYLOAD_MAX >= TELEMETRY_MAX_PAYLOAD, "transmit buffer too small for a record");
+static_assert(TX_PAYLOAD_MAX >= TELEMETRY_HEADER_SIZE + SAMPLE_BATCH_MAX * SAMPLE_MAX_ENTRY,
+              "transmit buffer too small for a batch of samples");
+
+// the frame being sent, word aligned so a DMA driven port could send it from here
+MBED_ALIGN(4) static uint8_t tx_buffer[FRAME_ENCODED_SIZE(TX_PAYLOAD_MAX)];
+static HistoryChunk chunk;      // the history chunk being sent, too big for the thread's stack
+
+MBED_ALIGN(8) static unsigned char telemetry_stack[MBED_CONF_APP_TELEMETRY_STACK_SIZE];
+static Thread t_telemetry(osPriorityLow, sizeof(telemetry_stack), telemetry_stack, "telemetry");
+
+// Purpose: answer a history dump request - send up to the requested number of chunks from its offset, stopping
+// after the first empty one, which tells the host it has caught up
+static void send_history(const TelemetryRecord &request, uint16_t &sequence) {
+    uint32_t offset = request.history.offset;
+    for (uint8_t i = 0; i < request.history.chunks; i++) {
+        history_read(offset, chunk);
+        FrameEncoder frame(tx_buffer, sizeof(tx_buffer));
+        telemetry_encode_history(chunk, sequence++, (uint32_t)Kernel::Clock::now().time_since_epoch().count(), frame);
+        size_t length = frame.finish();
+        telemetry_serial->write(tx_buffer, length);
+        if (chunk.count == 0) {
+            return;
+        }
+        offset = chunk.offset + chunk.count;
+    }
+}
+
+// Purpose: telemetry thread, frame each record as it arrives and write it to the port - with telemetry-compact,
+// consecutive samples are delta coded into one frame
+static void telemetry_server() {
+    SampleEncoder samples;
+    uint16_t sequence = 0;
+    TelemetryRecord *record = nullptr;
+
+    while (true) {
+        if (record == nullptr) {
+            record_queue.try_get_for(Kernel::wait_for_u32_forever, &record);
+        }
+        if (record->type == TELEMETRY_HISTORY) {
+            send_history(*record, sequence);
+            record_pool.free(record);
+            record = nullptr;
+            continue;
+        }
+
+        FrameEncoder frame(tx_buffer, sizeof(tx_buffer));
+        if (!MBED_CONF_APP_TELEMETRY_COMPACT || record->type != TELEMETRY_SAMPLE) {
+            telemetry_encode(*record, sequence++, frame);
+            record_pool.free(record);
+            record = nullptr;
+        }
+        else {
+            // pack this sample and the ones queued behind it, waiting up to telemetry-batch-ms for each
+            samples.begin(sequence++, record->time_ms, frame);
+            size_t count = 0;
+            do {
+                samples.add(*record, frame);
+                record_pool.free(record);
+                record = nullptr;
+                if (++count == SAMPLE_BATCH_MAX) {
+                    break;
+                }
+                record_queue.try_get_for(std::chrono::milliseconds(MBED_CONF_APP_TELEMETRY_BATCH_MS), &record);
+            } while (record != nullptr && record->type == TELEMETRY_SAMPLE);
+            // any other record that ended the batch goes out in the next frame
+        }
+        size_t length = frame.finish();
+        telemetry_serial->write(tx_buffer, length);     // blocks while the port's own buffer is full
+    }
+}
+
+void telemetry_start(BufferedSerial &serial) {
+    telemetry_serial = &serial;
+    t_telemetry.start(callback(telemetry_server));
+}
+
+bool telemetry_send(const TelemetryRecord &record) {
+    if (telemetry_serial == nullptr) {
+        return false;
+    }
+    TelemetryRecord *queued = record_pool.try_alloc();
+    if (queued == nullptr) {
+        dropped++;
+        return false;
+    }
+    *queued = record;
+    if (!record_queue.try_put(queued)) {
+        record_pool.free(queued);
+        dropped++;
+        return false;
+    }
+    return true;
+}
+
+uint32_t telemetry_dropped() {
+    return dropped;
+}
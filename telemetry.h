@@ -0,0 +1,48 @@
+// Binary telemetry stream for the climate monitor
+//
+// Samples, alerts and diagnostics are queued as fixed size records from any
+// task and sent by one low priority thread, which owns the serial port. Each
+// record is stuffed and CRC checked straight into a static transmit buffer
+// (see frame.h and telemetry_record.h for the format), so nothing is
+// formatted as text and nothing touches the heap. A record that finds the
+// queue full is dropped and counted rather than blocking its producer.
+//
+// With telemetry-compact, samples that are queued back to back are delta
+// coded into one frame (sample_codec.h), which at high sample rates cuts
+// the bytes per sample to about a third.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "mbed.h"
+#include "telemetry_record.h"
+
+#define TELEMETRY_QUEUE_DEPTH 16        // records that can be waiting to be sent at once
+
+/** Start the telemetry thread.
+ *
+ * From here on the thread is the only code that writes to the port.
+ *
+ * @param serial port the frames are written to
+ */
+void telemetry_start(BufferedSerial &serial);
+
+/** Queue a record to be sent.
+ *
+ * Never blocks, so it is safe from any thread and from ISRs. Does nothing
+ * until telemetry_start() has been called.
+ *
+ * @param record the record, copied into the queue
+ * @returns
+ *   true if the record was queued, false if telemetry is not running or the queue was full
+ */
+bool telemetry_send(const TelemetryRecord &record);
+
+/** Get the number of records dropped because the queue was full.
+ *
+ * @returns
+ *   dropped records since boot
+ */
+uint32_t telemetry_dropped();
+
+#endif
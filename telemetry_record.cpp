@@ -0,0 +1,154 @@
+// Telemetry records and their wire format
+
+#include "telemetry_record.h"
+
+// body length of each record type, 0 for unknown types
+static size_t body_size(uint8_t type) {
+    switch (type) {
+        case TELEMETRY_SAMPLE:
+            return 6;
+        case TELEMETRY_ALERT:
+            return 1;
+        case TELEMETRY_DIAG:
+            return 22;
+        case TELEMETRY_REPLY:
+            return 9;       // without the values
+        default:
+            return 0;
+    }
+}
+
+void telemetry_encode(const TelemetryRecord &record, uint16_t sequence, FrameEncoder &frame) {
+    frame.put(record.type);
+    frame.put_u16(sequence);
+    frame.put_u32(record.time_ms);
+    switch (record.type) {
+        case TELEMETRY_SAMPLE:
+            frame.put(record.sample.sensor);
+            frame.put(record.sample.valid);
+            frame.put_u16((uint16_t)record.sample.celcius);
+            frame.put_u16(record.sample.humidity);
+            break;
+        case TELEMETRY_ALERT:
+            frame.put(record.alert.reason);
+            break;
+        case TELEMETRY_DIAG:
+            frame.put_u16(record.diag.busy);
+            frame.put_u16(record.diag.sleep);
+            frame.put_u16(record.diag.stop);
+            frame.put_u32(record.diag.heap);
+            frame.put_u32(record.diag.reads);
+            frame.put_u32(record.diag.average_ua);
+            frame.put_u32(record.diag.dropped);
+            break;
+        case TELEMETRY_REPLY:
+            frame.put(record.reply.command);
+            frame.put_u16(record.reply.tag);
+            frame.put(record.reply.status);
+            frame.put_u32(record.reply.latency_us);
+            frame.put(record.reply.count);
+            for (uint8_t i = 0; i < record.reply.count; i++) {
+                frame.put_u32((uint32_t)record.reply.values[i]);
+            }
+            break;
+    }
+}
+
+bool telemetry_parse(const uint8_t *payload, size_t length, uint16_t &sequence, TelemetryRecord &record) {
+    if (length < TELEMETRY_HEADER_SIZE) {
+        return false;
+    }
+    size_t body = body_size(payload[0]);
+    if (body == 0 || length < TELEMETRY_HEADER_SIZE + body) {
+        return false;
+    }
+    if (payload[0] == TELEMETRY_REPLY) {
+        uint8_t count = payload[TELEMETRY_HEADER_SIZE + 8];
+        if (count > COMMAND_MAX_VALUES) {
+            return false;
+        }
+        body += 4 * count;
+    }
+    if (length != TELEMETRY_HEADER_SIZE + body) {
+        return false;
+    }
+    record.type = payload[0];
+    sequence = frame_get_u16(payload + 1);
+    record.time_ms = frame_get_u32(payload + 3);
+    const uint8_t *p = payload + TELEMETRY_HEADER_SIZE;
+    switch (record.type) {
+        case TELEMETRY_SAMPLE:
+            record.sample.sensor = p[0];
+            record.sample.valid = p[1];
+            record.sample.celcius = (int16_t)frame_get_u16(p + 2);
+            record.sample.humidity = frame_get_u16(p + 4);
+            break;
+        case TELEMETRY_ALERT:
+            record.alert.reason = p[0];
+            break;
+        case TELEMETRY_DIAG:
+            record.diag.busy = frame_get_u16(p);
+            record.diag.sleep = frame_get_u16(p + 2);
+            record.diag.stop = frame_get_u16(p + 4);
+            record.diag.heap = frame_get_u32(p + 6);
+            record.diag.reads = frame_get_u32(p + 10);
+            record.diag.average_ua = frame_get_u32(p + 14);
+            record.diag.dropped = frame_get_u32(p + 18);
+            break;
+        case TELEMETRY_REPLY:
+            record.reply.command = p[0];
+            record.reply.tag = frame_get_u16(p + 1);
+            record.reply.status = p[3];
+            record.reply.latency_us = frame_get_u32(p + 4);
+            record.reply.count = p[8];
+            for (uint8_t i = 0; i < record.reply.count; i++) {
+                record.reply.values[i] = (int32_t)frame_get_u32(p + 9 + 4 * i);
+            }
+            break;
+    }
+    return true;
+}
+
+void telemetry_encode_history(const HistoryChunk &chunk, uint16_t sequence, uint32_t time_ms, FrameEncoder &frame) {
+    frame.put(TELEMETRY_HISTORY);
+    frame.put_u16(sequence);
+    frame.put_u32(time_ms);
+    frame.put_u32(chunk.offset);
+    frame.put_u32(chunk.first);
+    frame.put_u32(chunk.end);
+    frame.put(chunk.count);
+    for (uint8_t i = 0; i < chunk.count; i++) {
+        const HistoryEntry &entry = chunk.entries[i];
+        frame.put_u32(entry.time_ms);
+        frame.put(entry.sensor);
+        frame.put(entry.valid);
+        frame.put_u16((uint16_t)entry.celcius);
+        frame.put_u16(entry.humidity);
+    }
+}
+
+bool telemetry_parse_history(const uint8_t *payload, size_t length, uint16_t &sequence, HistoryChunk &chunk) {
+    if (length < TELEMETRY_HEADER_SIZE + HISTORY_CHUNK_HEADER || payload[0] != TELEMETRY_HISTORY) {
+        return false;
+    }
+    const uint8_t *p = payload + TELEMETRY_HEADER_SIZE;
+    chunk.count = p[12];
+    if (chunk.count > HISTORY_CHUNK_ENTRIES ||
+        length != TELEMETRY_HEADER_SIZE + HISTORY_CHUNK_HEADER + (size_t)chunk.count * HISTORY_ENTRY_SIZE) {
+        return false;
+    }
+    sequence = frame_get_u16(payload + 1);
+    chunk.offset = frame_get_u32(p);
+    chunk.first = frame_get_u32(p + 4);
+    chunk.end = frame_get_u32(p + 8);
+    p += HISTORY_CHUNK_HEADER;
+    for (uint8_t i = 0; i < chunk.count; i++, p += HISTORY_ENTRY_SIZE) {
+        HistoryEntry &entry = chunk.entries[i];
+        entry.time_ms = frame_get_u32(p);
+        entry.sensor = p[4];
+        entry.valid = p[5];
+        entry.celcius = (int16_t)frame_get_u16(p + 6);
+        entry.humidity = frame_get_u16(p + 8);
+    }
+    return true;
+}
@@ -0,0 +1,158 @@
+// Telemetry records and their wire format
+//
+// Every record is sent as one frame (frame.h), except that samples are usually
+// packed several to a frame (sample_codec.h). The payload is:
+//
+//   type      u8    TELEMETRY_SAMPLE ... TELEMETRY_REPLY
+//   sequence  u16   frame counter, a gap means frames were lost
+//   time_ms   u32   Kernel clock time the record was made
+//   body            depends on type, see below
+//
+// Commands go the other way, one per frame:
+//
+//   command   u8    COMMAND_HISTORY ... COMMAND_STATS
+//   tag       u16   chosen by the host, returned in the command's TELEMETRY_REPLY
+//   arguments       depend on the command, see below
+//
+// All values are little endian, readings are fixed point tenths. Like
+// frame.h this file only depends on the C library so the host decoder
+// shares it.
+
+#ifndef TELEMETRY_RECORD_H
+#define TELEMETRY_RECORD_H
+
+#include "frame.h"
+
+// record types
+#define TELEMETRY_SAMPLE 1      // sensor u8, valid u8, celcius i16, humidity u16
+#define TELEMETRY_ALERT 2       // reason u8, as passed to show_alert()
+#define TELEMETRY_DIAG 3        // busy, sleep, stop u16 (permille), heap u32, reads u32, average_ua u32, dropped u32
+#define TELEMETRY_SAMPLES 4     // delta coded batch of samples, see sample_codec.h - not parsed by telemetry_parse()
+#define TELEMETRY_HISTORY 5     // offset u32, first u32, end u32, count u8, then count history entries:
+                                // time_ms u32, sensor u8, valid u8, celcius i16, humidity u16
+#define TELEMETRY_REPLY 6       // command u8, tag u16, status u8, latency_us u32, count u8, then count values i32
+
+#define TELEMETRY_HEADER_SIZE 7
+#define TELEMETRY_MAX_PAYLOAD (TELEMETRY_HEADER_SIZE + 9 + COMMAND_MAX_VALUES * 4)     // largest single record
+
+// commands and their arguments, each is answered with a TELEMETRY_REPLY holding the values listed after "->"
+#define COMMAND_HISTORY 0x81            // offset u32, chunks u8 - send stored history from offset, at most chunks
+                                        // TELEMETRY_HISTORY frames, before the reply
+#define COMMAND_GET_THRESHOLDS 0x82     // -> temp_min, temp_max, humidity_min, humidity_max
+#define COMMAND_SET_THRESHOLDS 0x83     // temp_min, temp_max, humidity_min, humidity_max i16
+#define COMMAND_GET_UNIT 0x84           // -> 1 for Celcius, 0 for Fahrenheit
+#define COMMAND_SET_UNIT 0x85           // unit u8, 1 for Celcius, 0 for Fahrenheit
+#define COMMAND_GET_PERIOD 0x86         // sensor u8 -> current period ms, fixed period ms (0 when adaptive)
+#define COMMAND_SET_PERIOD 0x87         // sensor u8, period_ms u32 - read the sensor at a fixed period, 0 to adapt it
+#define COMMAND_STATS 0x88              // -> uptime s, sensor reads, telemetry dropped, commands, worst command
+                                        // latency us, heap bytes
+#define COMMAND_MAX_VALUES 6            // values in one reply
+
+// reply status
+#define COMMAND_OK 0
+#define COMMAND_ERROR_UNKNOWN 1         // no such command
+#define COMMAND_ERROR_ARGS 2            // wrong number of argument bytes
+#define COMMAND_ERROR_RANGE 3           // an argument is out of range
+#define COMMAND_ERROR_BUSY 4            // the device could not take the command now, try again
+
+#define HISTORY_CHUNK_HEADER 13         // offset, first, end, count
+#define HISTORY_ENTRY_SIZE 10           // bytes of one history entry on the wire
+#define HISTORY_CHUNK_ENTRIES 24        // entries in one TELEMETRY_HISTORY frame
+#define HISTORY_PAYLOAD (TELEMETRY_HEADER_SIZE + HISTORY_CHUNK_HEADER + HISTORY_CHUNK_ENTRIES * HISTORY_ENTRY_SIZE)
+
+/// one record, only the member matching type is used
+struct TelemetryRecord {
+    uint8_t type;
+    uint32_t time_ms;
+    union {
+        struct {
+            uint8_t sensor;
+            uint8_t valid;
+            int16_t celcius;        // tenths of a degree Celcius
+            uint16_t humidity;      // tenths of a percent RH
+        } sample;
+        struct {
+            uint8_t reason;
+        } alert;
+        struct {
+            uint32_t offset;        // first entry wanted
+            uint8_t chunks;         // frames to send at most
+        } history;                  // queued on the device only, answered with TELEMETRY_HISTORY frames
+        struct {
+            uint8_t command;
+            uint8_t status;         // COMMAND_OK or a COMMAND_ERROR
+            uint8_t count;          // values used
+            uint16_t tag;
+            uint32_t latency_us;    // from the command being read off the port to the reply being queued
+            int32_t values[COMMAND_MAX_VALUES];
+        } reply;
+        struct {
+            uint16_t busy;          // permille of the report window
+            uint16_t sleep;
+            uint16_t stop;
+            uint32_t heap;          // bytes allocated
+            uint32_t reads;         // sensor reads since boot
+            uint32_t average_ua;    // energy estimate
+            uint32_t dropped;       // records lost because the telemetry queue was full
+        } diag;
+    };
+};
+
+/// one stored sample
+struct HistoryEntry {
+    uint32_t time_ms;
+    uint8_t sensor;
+    uint8_t valid;
+    int16_t celcius;
+    uint16_t humidity;
+};
+
+/// a run of stored samples, as sent in one TELEMETRY_HISTORY frame
+struct HistoryChunk {
+    uint32_t offset;        // index of entries[0], counted from the first sample stored since boot
+    uint32_t first;         // oldest index still stored, older ones were overwritten
+    uint32_t end;           // index the next sample will be stored at
+    uint8_t count;          // entries in this chunk, 0 once offset has caught up with end
+    HistoryEntry entries[HISTORY_CHUNK_ENTRIES];
+};
+
+/** Write a record into a frame.
+ *
+ * @param record record to send
+ * @param sequence the frame's sequence number
+ * @param frame encoder the payload is put into, finish() is left to the caller
+ */
+void telemetry_encode(const TelemetryRecord &record, uint16_t sequence, FrameEncoder &frame);
+
+/** Read a record from a decoded frame payload.
+ *
+ * @param payload bytes returned by frame_decode()
+ * @param length payload length
+ * @param sequence receives the frame's sequence number
+ * @param record receives the record
+ * @returns
+ *   true on success, false for an unknown type or a payload of the wrong length
+ */
+bool telemetry_parse(const uint8_t *payload, size_t length, uint16_t &sequence, TelemetryRecord &record);
+
+/** Write a history chunk into a frame.
+ *
+ * @param chunk entries to send
+ * @param sequence the frame's sequence number
+ * @param time_ms Kernel clock time the chunk was sent
+ * @param frame encoder the payload is put into, finish() is left to the caller
+ */
+void telemetry_encode_history(const HistoryChunk &chunk, uint16_t sequence, uint32_t time_ms, FrameEncoder &frame);
+
+/** Read a history chunk from a decoded TELEMETRY_HISTORY frame payload.
+ *
+ * @param payload bytes returned by frame_decode()
+ * @param length payload length
+ * @param sequence receives the frame's sequence number
+ * @param chunk receives the chunk
+ * @returns
+ *   true on success, false if the payload is not a well formed chunk
+ */
+bool telemetry_parse_history(const uint8_t *payload, size_t length, uint16_t &sequence, HistoryChunk &chunk);
+
+#endif